@@ -0,0 +1,76 @@
+#include "hula_generated.hpp"
+#include <chrono>
+#include <fmt/format.h>
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+// The element-wise conversion all marshalling helpers used before the bulk copy kernels
+template <class T, class X>
+void copy_elementwise(std::vector<T>& lhs, std::vector<X> const& rhs)
+{
+  lhs.resize(rhs.size());
+  for (std::size_t i = 0, ie = rhs.size(); i < ie; ++i)
+    lhs[i] = static_cast<T>(rhs[i]);
+}
+
+template <class T, class X>
+void copy_bulk(std::vector<T>& lhs, std::vector<X> const& rhs)
+{
+  lhs.resize(rhs.size());
+  hula::detail::copy_elements(lhs.data(), rhs.data(), rhs.size());
+}
+
+// Returns the throughput in million elements per second
+template <class T, class X, class Kernel>
+double measure(std::size_t N, Kernel kernel)
+{
+  std::vector<X> input(N);
+  for (std::size_t i = 0; i < N; ++i)
+    input[i] = static_cast<X>(i % 1000);
+  std::vector<T> output;
+
+  // Repeat until the measurement is long enough to be meaningful
+  std::size_t repetitions = 0;
+  auto const start = clock_type::now();
+  auto elapsed = clock_type::duration{};
+  do
+  {
+    kernel(output, input);
+    ++repetitions;
+    elapsed = clock_type::now() - start;
+  } while (elapsed < std::chrono::milliseconds(200));
+
+  // Keep the compiler from discarding the copies
+  if (output[N / 2] != static_cast<T>(input[N / 2]))
+    fmt::print("Mismatch!\n");
+
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  return static_cast<double>(N) * static_cast<double>(repetitions) / seconds / 1e6;
+}
+
+template <class T, class X>
+void compare(char const* label)
+{
+  for (std::size_t N : {std::size_t{1} << 10, std::size_t{1} << 16, std::size_t{1} << 22})
+  {
+    auto elementwise = measure<T, X>(N, copy_elementwise<T, X>);
+    auto bulk = measure<T, X>(N, copy_bulk<T, X>);
+    fmt::print("{0:<16} {1:>8} {2:>14.1f} {3:>14.1f} {4:>8.2f}x\n", label, N, elementwise, bulk, bulk / elementwise);
+  }
+}
+
+}
+
+int main()
+{
+  fmt::print("{0:<16} {1:>8} {2:>14} {3:>14} {4:>9}\n", "conversion", "elements", "loop [M/s]", "bulk [M/s]", "speedup");
+  compare<std::int32_t, std::int32_t>("int32 -> int32");
+  compare<double, double>("double -> double");
+  compare<std::int32_t, std::uint16_t>("uint16 -> int32");
+  compare<std::uint16_t, std::int32_t>("int32 -> uint16");
+  compare<float, double>("double -> float");
+  return 0;
+}
@@ -0,0 +1,6 @@
+# Finds the installed hula executable and provides hula_generate()
+get_filename_component(_hula_prefix "${CMAKE_CURRENT_LIST_DIR}/../../.." ABSOLUTE)
+find_program(HULA_EXECUTABLE hula HINTS ${_hula_prefix}/bin)
+unset(_hula_prefix)
+
+include(${CMAKE_CURRENT_LIST_DIR}/hula_generate.cmake)
@@ -0,0 +1,62 @@
+# hula_generate(<target> SPECS <spec>... [OUTPUT_DIRECTORY <dir>] [SHARDS <count>])
+#
+# Generates the tango glue for the given specs and adds it to <target>. The code is regenerated
+# whenever a spec or the hula executable changes. Outputs that did not change keep their
+# timestamps, so only the affected sources are recompiled.
+#
+# hula lists the outputs while configuring, so the hula executable has to exist by then. It is looked up
+# on the path unless HULA_EXECUTABLE points to it.
+function(hula_generate TARGET)
+  cmake_parse_arguments(PARSE_ARGV 1 HULA "" "OUTPUT_DIRECTORY;SHARDS" "SPECS")
+  if(NOT HULA_SPECS)
+    message(FATAL_ERROR "hula_generate(${TARGET}) needs at least one spec")
+  endif()
+  if(NOT HULA_OUTPUT_DIRECTORY)
+    set(HULA_OUTPUT_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_hula)
+  endif()
+
+  find_program(HULA_EXECUTABLE hula)
+  if(NOT HULA_EXECUTABLE)
+    message(FATAL_ERROR "Could not find the hula executable")
+  endif()
+
+  set(specs)
+  foreach(spec IN LISTS HULA_SPECS)
+    get_filename_component(spec ${spec} ABSOLUTE)
+    list(APPEND specs ${spec})
+  endforeach()
+
+  set(options)
+  if(HULA_SHARDS)
+    list(APPEND options --shards ${HULA_SHARDS})
+  endif()
+
+  # The outputs depend on the specs' contents, so editing a spec or updating hula reconfigures to pick them up
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${specs} ${HULA_EXECUTABLE})
+  execute_process(
+    COMMAND ${HULA_EXECUTABLE} --list-outputs ${options} ${specs} ${HULA_OUTPUT_DIRECTORY}
+    OUTPUT_VARIABLE outputs
+    ERROR_VARIABLE error
+    RESULT_VARIABLE result
+    OUTPUT_STRIP_TRAILING_WHITESPACE)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "hula_generate(${TARGET}): ${error}")
+  endif()
+  string(REPLACE "\n" ";" outputs "${outputs}")
+
+  # hula leaves unchanged outputs alone, so some of them are always older than the specs. As OUTPUTs they
+  # would rerun hula on every build, so a stamp stands in for all of them.
+  set(stamp ${HULA_OUTPUT_DIRECTORY}/hula_generated.stamp)
+  add_custom_command(
+    OUTPUT ${stamp}
+    BYPRODUCTS ${outputs}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${HULA_OUTPUT_DIRECTORY}
+    COMMAND ${HULA_EXECUTABLE} ${options} ${specs} ${HULA_OUTPUT_DIRECTORY}
+    COMMAND ${CMAKE_COMMAND} -E touch ${stamp}
+    DEPENDS ${specs} ${HULA_EXECUTABLE}
+    COMMENT "Generating tango glue for ${TARGET}"
+    VERBATIM)
+
+  target_sources(${TARGET} PRIVATE ${stamp} ${outputs})
+  target_include_directories(${TARGET} PRIVATE ${HULA_OUTPUT_DIRECTORY})
+endfunction()
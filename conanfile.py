@@ -10,7 +10,7 @@ class HulaRecipe(ConanFile):
     package_type = "application"
     settings = "os", "compiler", "build_type", "arch"
     url = "https://github.com/softwareschneiderei/hula"
-    exports_sources = "CMakeLists.txt", "main.cpp", "source/*", "tests/*"
+    exports_sources = "CMakeLists.txt", "main.cpp", "cmake/*", "source/*", "tests/*"
     requires = "toml11/3.8.1", "fmt/10.2.1"
     test_requires = "catch2/3.6.0"
     generators = "CMakeDeps"
@@ -31,3 +31,12 @@ class HulaRecipe(ConanFile):
         extension = ".exe" if self.settings_build.os == "Windows" else ""
         copy(self, "*hula{}".format(extension),
              self.build_folder, os.path.join(self.package_folder, "bin"), keep_path=False)
+        copy(self, "hula_generate.cmake",
+             os.path.join(self.source_folder, "cmake"), os.path.join(self.package_folder, "lib", "cmake", "hula"))
+
+    def package_info(self):
+        # Consumers get hula_generate() with find_package(hula)
+        self.cpp_info.builddirs = [os.path.join("lib", "cmake", "hula")]
+        self.cpp_info.set_property("cmake_build_modules", [os.path.join("lib", "cmake", "hula", "hula_generate.cmake")])
+        self.cpp_info.includedirs = []
+        self.cpp_info.libdirs = []
@@ -1,5 +1,7 @@
 #include "hula_generated.hpp"
+#include <atomic>
 #include <iostream>
+#include <stdexcept>
 
 class cool_camera : public hula::cool_camera_base
 {
@@ -37,6 +39,9 @@ public:
   void record() override
   {
     std::cout << "Recording!" << std::endl;
+    // Usually called from the acquisition thread
+    publish_histogram(std::vector<std::int32_t>(256, 1));
+    notify_image_ready(++frame_number_);
   }
 
   std::int32_t square(std::int32_t rhs) override
@@ -64,14 +69,11 @@ public:
     return {};
   }
 
-  image<std::int32_t> read_raw_image() override
+  void read_raw_image(image<std::uint16_t>& value) override
   {
-    return {};
-  }
-
-  std::vector<std::int32_t> read_histogram() override
-  {
-    return {};
+    value.data.resize(16 * 16);
+    value.width = 16;
+    value.height = 16;
   }
 
   operating_state_result operating_state() override
@@ -84,6 +86,7 @@ private:
   std::int32_t binning_ = 42;
   std::string address_;
   std::string notes_;
+  std::int32_t frame_number_ = 0;
 };
 
 class camera_stand : public hula::camera_stand_base
@@ -93,6 +96,15 @@ public:
   {
   }
 
+  void read_attributes(attribute_set const& requested) override
+  {
+    // A real stand would fetch everything requested in a single bus transaction here
+    if (requested.contains(attribute_id::position))
+    {
+      position_ = {actual_x_, actual_y_};
+    }
+  }
+
   std::string read_notes() override
   {
     return notes_;
@@ -105,13 +117,16 @@ public:
 
   std::vector<double> read_position() override
   {
-    return {actual_x_, actual_y_};
+    return position_;
   }
 
-  void write_position(std::vector<double> const& rhs) override
+  void write_position(span<double const> rhs) override
   {
-    actual_x_ = rhs.at(0);
-    actual_y_ = rhs.at(1);
+    if (rhs.size() != 2)
+      throw std::invalid_argument("Position needs exactly two coordinates");
+    actual_x_ = rhs[0];
+    actual_y_ = rhs[1];
+    push_position({actual_x_, actual_y_});
   }
 
   void move(std::vector<double> const& rhs) override
@@ -126,17 +141,31 @@ public:
     actual_y_ = target_y_;
   }
 
+  void sample_path(std::int32_t rhs, output_array<double>& result) override
+  {
+    if (rhs < 2)
+      throw std::invalid_argument("Need at least two points");
+
+    auto points = result.resize(2 * static_cast<std::size_t>(rhs));
+    for (std::int32_t i = 0; i < rhs; ++i)
+    {
+      auto t = static_cast<double>(i) / (rhs - 1);
+      points[2 * i] = actual_x_ + t * (target_x_ - actual_x_);
+      points[2 * i + 1] = actual_y_ + t * (target_y_ - actual_y_);
+    }
+  }
+
   std::vector<std::int32_t> read_steps() override
   {
-    return std::vector<std::int32_t>();
+    return {static_cast<std::int32_t>(actual_x_ * 100.), static_cast<std::int32_t>(actual_y_ * 100.)};
   }
 
-  image<std::int32_t> read_label_image() override
+  image<std::int16_t> read_label_image() override
   {
     return label_image_;
   }
 
-  void write_label_image(image<std::int32_t> const& rhs) override
+  void write_label_image(image<std::int16_t> const& rhs) override
   {
     label_image_ = rhs;
   }
@@ -145,11 +174,13 @@ private:
   double target_x_ = 0.;
   double target_y_ = 0.;
   
-  double actual_x_ = 0.;
-  double actual_y_ = 0.;
+  // read_steps() reads these from the refresh thread
+  std::atomic<double> actual_x_{0.};
+  std::atomic<double> actual_y_{0.};
 
   std::string notes_;
-  image<std::int32_t> label_image_;
+  std::vector<double> position_;
+  image<std::int16_t> label_image_;
 };
 
 int main(int argc, char* argv[])
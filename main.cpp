@@ -5,14 +5,24 @@
 #include <iostream>
 #include <filesystem>
 #include <unordered_set>
+#include <string_view>
+#include <optional>
 
 
 void check_names(std::vector<device_server_spec> const& spec_list)
 {
+  // These would clash with the headers that are generated independent of the specs
+  std::unordered_set<std::string> const reserved_names{"common", "generated", "internal", "shm"};
+
   std::unordered_set<std::string> seen_names;
   for (auto const& spec : spec_list)
   {
     auto name = spec.name.snake_cased();
+    if (reserved_names.count(name) != 0)
+    {
+      throw std::invalid_argument(fmt::format("Reserved name: \"{0}\"", name));
+    }
+
     auto [_, inserted] = seen_names.insert(name);
     if (!inserted)
     {
@@ -24,31 +34,79 @@ void check_names(std::vector<device_server_spec> const& spec_list)
 
 int run(int argc, char* argv[])
 {
-  if (argc < 3)
+  // Options come first
+  generator_options options;
+  std::optional<std::filesystem::path> depfile_path;
+  bool list_only = false;
+  int first = 1;
+  for (; first < argc && std::string_view{argv[first]}.substr(0, 2) == "--"; ++first)
   {
-    fmt::print("{0} <spec> (<spec> ...) <output-path>\n", argv[0]);
+    std::string_view option{argv[first]};
+    if (option == "--list-outputs")
+    {
+      list_only = true;
+      continue;
+    }
+
+    if (first + 1 >= argc)
+    {
+      throw std::invalid_argument(fmt::format("{0} needs a value", option));
+    }
+
+    ++first;
+    if (option == "--shards")
+      options.shards = parse_shard_count(argv[first]);
+    else if (option == "--depfile")
+      depfile_path = argv[first];
+    else
+      throw std::invalid_argument(fmt::format("Unknown option {0}", option));
+  }
+
+  if (argc - first < 2)
+  {
+    fmt::print("{0} [--list-outputs] [--shards <count>] [--depfile <path>] <spec> (<spec> ...) <output-path>\n", argv[0]);
     return EXIT_FAILURE;
   }
 
   // The number of specs
-  auto const N = argc - 2;
+  auto const N = argc - first - 1;
   std::filesystem::path output_path{argv[argc-1]};
-  if (!exists(output_path))
+  // Listing runs before the build created the output path
+  if (!list_only && !exists(output_path))
   {
     fmt::print("Output path {0} does not exist\n", output_path.string());
     return EXIT_FAILURE;
   }
 
   std::vector<device_server_spec> spec_list;
+  std::vector<std::filesystem::path> spec_paths;
   for (int i = 0; i < N; ++i)
   {
-    auto input = toml::parse(argv[i+1]);
+    auto input = toml::parse(argv[first+i]);
     auto spec = toml::get<device_server_spec>(input);
     spec_list.push_back(spec);
+    spec_paths.push_back(std::filesystem::absolute(argv[first+i]));
   }
 
   check_names(spec_list);
-  generate_code(spec_list, output_path);
+  if (list_only)
+  {
+    // One per line with forward slashes, as CMake expects them
+    for (auto const& output : list_outputs(spec_list, output_path, options))
+    {
+      fmt::print("{0}\n", output.generic_string());
+    }
+    return EXIT_SUCCESS;
+  }
+
+  generate_code(spec_list, output_path, options);
+
+  // The umbrella header stands in for all outputs, since it is the one that is always generated
+  if (depfile_path)
+  {
+    auto target = std::filesystem::absolute(output_path / "hula_generated.hpp");
+    write_if_changed(*depfile_path, build_depfile(target, spec_paths));
+  }
 
   return EXIT_SUCCESS;
 }
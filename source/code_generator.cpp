@@ -1,4 +1,10 @@
 #include "code_generator.hpp"
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
 
 using namespace std::string_literals;
 
@@ -53,14 +59,25 @@ class {0}
 public:
   template <class T>
   using image = hula::image<T>;
+  template <class T>
+  using image_view = hula::image_view<T>;
+  using rgb24 = hula::rgb24;
+  template <class T>
+  using span = hula::span<T>;
+  template <class T>
+  using output_array = hula::output_array<T>;
   using device_state = hula::device_state;
   using operating_state_result = hula::operating_state_result;
   using factory_type = std::function<std::unique_ptr<{0}>({1} const& properties)>;
-
+{3}
   virtual ~{0}() = default;
 {2}
   // special
   virtual operating_state_result operating_state();
+
+private:
+  friend struct hula::adaptor_access;
+  hula::device_context* context_ = nullptr;{4}
 }};
 
 inline operating_state_result {0}::operating_state()
@@ -79,16 +96,15 @@ public:
   {0}(Tango::DeviceClass* cl, char const* name, factory_type factory)
   : TANGO_BASE_CLASS(cl, name)
   , factory_(std::move(factory))
-  {{
+  {{{14}
     {0}::init_device();
   }}
 
   void init_device() final
   {{
     try
-    {{
-      impl_.reset();
-      impl_ = factory_(load_device_properties());
+    {{{10}
+      impl_.reset();{11}
     }}
     catch(...)
     {{
@@ -96,38 +112,58 @@ public:
     }}
   }}
 
+  void adopt(std::unique_ptr<{1}> impl)
+  {{
+    if (!impl)
+      throw std::invalid_argument("The factory of " + get_name() + " returned no implementation");
+    impl_ = std::move(impl);
+    adaptor_access::attach(*impl_, &context_);{5}
+  }}
+
   static {1}* get(Tango::DeviceImpl* device)
   {{
-    return static_cast<{0}*>(device)->impl_.get();
+    auto self = static_cast<{0}*>(device);{12}
   }}
 
+  static Tango::DbData property_names()
+  {{
+    return {{{13}}};
+  }}
+
+  // Filled by the device class for all its devices at once
+  inline static property_prefetch prefetched_properties_{{}};
+
   {2} load_device_properties()
   {{{3}
   }}
 
   Tango::DevState dev_state() final
   {{
-    store_operating_state(impl_->operating_state());
+    refresh_operating_state();
 	  return get_state();
   }}
 
   Tango::ConstDevString dev_status() final
   {{
-    store_operating_state(impl_->operating_state());
+    refresh_operating_state();
     return Tango::DeviceImpl::dev_status();
   }}
 
+  void refresh_operating_state()
+  {{{6}
+    store_operating_state(get(this)->operating_state());{7}
+  }}
+
   void store_operating_state(operating_state_result const& current)
   {{
     auto state = convert_state(current.state);
     set_state(state);
-    set_status(current.status);
-	  if (state!=Tango::ALARM)
-		  Tango::DeviceImpl::dev_state();
+    set_status(current.status);{8}
   }}
-
-private:
+{4}
+private:{9}
   factory_type factory_;
+  device_context context_{{this}};
   std::unique_ptr<{1}> impl_;
 }};
 )";
@@ -138,7 +174,7 @@ class {0} : public Tango::DeviceClass
 {{
 public:
   using factory_type = {1}::factory_type;
-  static factory_type factory_;
+  static factory_type factory_;{11}
 
   static Tango::DeviceClass* create()
   {{
@@ -167,12 +203,13 @@ public:
   }}
 
   void device_factory(Tango::DevVarStringArray const* devlist_ptr)
-  {{
+  {{{10}
 	  for (unsigned long i=0; i<devlist_ptr->length(); i++)
 	  {{
-		  device_list.push_back(new {1}(this, (*devlist_ptr)[i], factory_));
+		  auto dev = new {1}(this, (*devlist_ptr)[i], factory_{9});{7}
+		  device_list.push_back(dev);
 	  }}
-
+{8}
 	  for (unsigned long i=1; i<=devlist_ptr->length(); i++)
 	  {{
 		  auto dev = device_list[device_list.size()-i];
@@ -189,7 +226,7 @@ public:
 }};
 
 // Define the static factory
-{0}::factory_type {0}::factory_;
+{0}::factory_type {0}::factory_;{12}
 )";
 
 constexpr char const* ATTRIBUTE_CLASS_TEMPLATE = R"(
@@ -203,23 +240,81 @@ public:
 }};
 )";
 
-constexpr char const* ATTRIBUTE_READ_FUNCTION_TEMPLATE = R"(
-  {1} read_value{{}};
+constexpr char const* ATTRIBUTE_READ_FUNCTION_TEMPLATE = R"({5}
   void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
-  {{
+  {{{6}
     auto impl = {0}::get(dev);
     try
     {{
-      to_tango<{3}>::assign(read_value, impl->read_{2}());
+      {3}::assign(read_value, impl->read_{2}());
     }}
     catch(...)
     {{
       convert_exception();
+    }}{7}
+    attr.set_value({4});
+  }}
+)";
+
+constexpr char const* ATTRIBUTE_READ_SNAPSHOT_FUNCTION_TEMPLATE = R"({5}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{6}
+    auto impl = {0}::get(dev);{7}
+    auto latest = adaptor_access::snapshots(*impl).{2}.latest();
+    if (latest == nullptr)
+    {{
+      // Nothing was published yet, or the last refresh failed
+      attr.set_quality(Tango::ATTR_INVALID);
+      return;
     }}
+    {3}::assign(read_value, *latest);{8}
     attr.set_value({4});
   }}
 )";
 
+constexpr char const* ATTRIBUTE_READ_IN_PLACE_FUNCTION_TEMPLATE = R"({4}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{5}
+    auto impl = {0}::get(dev);
+    try
+    {{
+      impl->read_{2}(read_value);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+    attr.set_value({3});
+  }}
+)";
+
+constexpr char const* ATTRIBUTE_READ_VIEW_FUNCTION_TEMPLATE = R"({4}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{5}
+    auto impl = {0}::get(dev);
+    try
+    {{
+      read_value = impl->read_{2}();
+      // Tango would reject it as well, but without naming the attribute or the sizes
+      if (read_value.width > {6} || read_value.height > {7})
+        throw std::length_error("read_{2} returned " + std::to_string(read_value.width) + "x" +
+          std::to_string(read_value.height) + " pixels, but the attribute holds at most {6}x{7}");
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+    // A contiguous view is handed over as it is, so the buffer keeps its owner alive until tango marshalled the pixels.
+    // A gathered one is not needed anymore.
+    auto pixels = gather<{3}>(read_value, gathered_value);
+    auto width = read_value.width;
+    auto height = read_value.height;
+    if (!read_value.is_contiguous())
+      read_value = {{}};
+    attr.set_value(pixels, width, height);
+  }}
+)";
+
 constexpr char const* ATTRIBUTE_WRITE_FUNCTION_TEMPLATE = R"(
   void write(Tango::DeviceImpl* dev, Tango::WAttribute& attr) final
   {{
@@ -275,9 +370,54 @@ std::string write_temporary_type(attribute_type_t const& type)
   };
 }
 
-std::string attribute_class(std::string const& ds_name, attribute const& input)
+std::string set_value_arguments(attribute_type_t const& type, std::string const& value)
+{
+  switch (type.rank)
+  {
+  default:
+  case attribute_rank_t::scalar:
+    return fmt::format("&{0}", value);
+
+  case attribute_rank_t::spectrum:
+    return fmt::format("{0}.data(), {0}.size()", value);
+
+  case attribute_rank_t::image:
+    return fmt::format("{0}.data.data(), {0}.width, {0}.height", value);
+  }
+}
+
+// Tango hands the read buffer over by pointer and marshals it later in the same thread.
+// The attribute objects belong to the device class, so all its devices share them. A member is only enough
+// when tango serializes the whole class or process, otherwise every thread needs its own.
+bool has_concurrent_reads(serialization_t serialization)
+{
+  return serialization == serialization_t::by_device || serialization == serialization_t::none;
+}
+
+std::string read_buffer_member(std::string const& type, bool concurrent_reads, char const* name = "read_value")
+{
+  return concurrent_reads ? ""s : fmt::format("\n  {0} {1}{{}};", type, name);
+}
+
+std::string read_buffer_local(std::string const& type, bool concurrent_reads, char const* name = "read_value")
+{
+  return concurrent_reads ? fmt::format("\n    static thread_local {0} {1}{{}};", type, name) : ""s;
+}
+
+// The conversion from the user's value to the read buffer
+std::string read_converter(attribute const& input)
+{
+  if (input.encoding == encoding_t::jpeg)
+  {
+    return fmt::format("jpeg_to_tango<{0}>", input.jpeg_quality);
+  }
+  return fmt::format("to_tango<{0}>", cpp_type(input.type));
+}
+
+std::string attribute_class(std::string const& ds_name, attribute const& input, serialization_t serialization)
 {
   std::ostringstream str;
+  auto concurrent_reads = has_concurrent_reads(serialization);
 
   std::string additional_ctor_args;
   std::string attribute_base_class;
@@ -296,31 +436,94 @@ std::string attribute_class(std::string const& ds_name, attribute const& input)
     attribute_base_class = "Tango::Attr";
     break;
   };
-  if (is_readable(input.access))
+  if (is_readable(input.access) && input.read_mode == read_mode_t::in_place)
   {
+    // The buffer has the user's element type, which is layout compatible to the tango type
     std::string set_value_args;
+    auto element_type = tango_type(input.type.type, false);
     if (input.type.rank == attribute_rank_t::spectrum)
     {
-      set_value_args = "read_value.data(), read_value.size()"s;
+      set_value_args = fmt::format("layout_cast<{0}>(read_value.data()), read_value.size()", element_type);
     }
-    else if (input.type.rank == attribute_rank_t::image)
+    else
     {
-      set_value_args = "read_value.data.data(), read_value.width, read_value.height"s;
+      set_value_args = fmt::format("layout_cast<{0}>(read_value.data.data()), read_value.width, read_value.height", element_type);
     }
-    else
+
+    auto buffer_type = cpp_type(input.type);
+    str << fmt::format(ATTRIBUTE_READ_IN_PLACE_FUNCTION_TEMPLATE,
+      ds_name, buffer_type, input.name.snake_cased(), set_value_args,
+      read_buffer_member(buffer_type, concurrent_reads), read_buffer_local(buffer_type, concurrent_reads));
+  }
+  else if (is_readable(input.access) && input.read_mode == read_mode_t::view)
+  {
+    auto view_type = fmt::format("image_view<{0} const>", cpp_type(input.type.type, false));
+    auto element_type = tango_type(input.type.type, false);
+    auto gathered_type = fmt::format("std::vector<{0}>", element_type);
+    str << fmt::format(ATTRIBUTE_READ_VIEW_FUNCTION_TEMPLATE,
+      ds_name, view_type, input.name.snake_cased(), element_type,
+      read_buffer_member(view_type, concurrent_reads) + read_buffer_member(gathered_type, concurrent_reads, "gathered_value"),
+      read_buffer_local(view_type, concurrent_reads) + read_buffer_local(gathered_type, concurrent_reads, "gathered_value"),
+      input.type.max_size[0], input.type.max_size[1]);
+  }
+  else if (is_readable(input.access))
+  {
+    // Reduced attributes hand tango a second buffer with the cropped and binned or decimated values
+    auto buffer_type = read_value_type(input.type);
+    auto buffer_member = read_buffer_member(buffer_type, concurrent_reads);
+    auto buffer_local = read_buffer_local(buffer_type, concurrent_reads);
+    auto set_value_args = set_value_arguments(input.type, "read_value");
+    std::string reduce;
+    if (input.reduction)
     {
-      set_value_args = "&read_value"s;
+      buffer_member += read_buffer_member(buffer_type, concurrent_reads, "reduced_value");
+      buffer_local += read_buffer_local(buffer_type, concurrent_reads, "reduced_value");
+      set_value_args = set_value_arguments(input.type, "reduced_value");
+      constexpr char const* REDUCE_TEMPLATE = R"(
+    try
+    {{
+      {0}::reductions(dev).{1}.apply(read_value, reduced_value);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }})";
+      reduce = fmt::format(REDUCE_TEMPLATE, ds_name, input.name.snake_cased());
     }
 
-    str << fmt::format(ATTRIBUTE_READ_FUNCTION_TEMPLATE,
-      ds_name, read_value_type(input.type), input.name.snake_cased(),
-      cpp_type(input.type), set_value_args);
+    if (has_snapshot(input))
+    {
+      // The snapshot has a single reading side, which needs a guard when tango does not serialize at all
+      auto guard = serialization == serialization_t::none
+        ? "\n    static std::mutex reader_mutex;\n    std::lock_guard<std::mutex> lock(reader_mutex);"s : ""s;
+      str << fmt::format(ATTRIBUTE_READ_SNAPSHOT_FUNCTION_TEMPLATE,
+        ds_name, buffer_type, input.name.snake_cased(),
+        read_converter(input), set_value_args, buffer_member, buffer_local, guard, reduce);
+    }
+    else
+    {
+      str << fmt::format(ATTRIBUTE_READ_FUNCTION_TEMPLATE,
+        ds_name, buffer_type, input.name.snake_cased(),
+        read_converter(input), set_value_args, buffer_member, buffer_local, reduce);
+    }
   }
 
   if (is_writable(input.access))
   {
     std::string argument = "arg"s;
-    if (input.type.rank == attribute_rank_t::spectrum)
+    if (input.write_mode == write_mode_t::view)
+    {
+      auto element_type = cpp_type(input.type.type, false);
+      if (input.type.rank == attribute_rank_t::spectrum)
+      {
+        argument = fmt::format("span<{0} const>{{layout_cast<{0} const>(arg),\n        static_cast<std::size_t>(attr.get_w_dim_x())}}", element_type);
+      }
+      else
+      {
+        argument = fmt::format("image_view<{0} const>{{layout_cast<{0} const>(arg),\n        static_cast<std::size_t>(attr.get_w_dim_x()),\n        static_cast<std::size_t>(attr.get_w_dim_y())}}", element_type);
+      }
+    }
+    else if (input.type.rank == attribute_rank_t::spectrum)
     {
       argument = fmt::format("std::vector<{0}>{{arg, arg+attr.get_w_dim_x()}}", cpp_type(input.type.type, false));
     }
@@ -341,6 +544,145 @@ std::string attribute_class(std::string const& ds_name, attribute const& input)
     str.str(), additional_ctor_args, attribute_base_class);
 }
 
+constexpr char const* REDUCTION_ROI_CLASS_TEMPLATE = R"(
+class {0}RoiAttrib : public Tango::SpectrumAttr
+{{
+public:
+  {0}RoiAttrib()
+  : Tango::SpectrumAttr("{0}Roi", Tango::DEV_ULONG, Tango::READ_WRITE, {1}) {{}}
+  ~{0}RoiAttrib() final = default;
+{4}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{5}
+    auto roi = {2}::reductions(dev).{3}.roi();
+    std::copy(roi.begin(), roi.end(), read_value.begin());
+    attr.set_value(read_value.data(), read_value.size());
+  }}
+
+  void write(Tango::DeviceImpl* dev, Tango::WAttribute& attr) final
+  {{
+    Tango::DevULong const* arg = nullptr;
+    attr.get_write_value(arg);
+    try
+    {{
+      if (attr.get_w_dim_x() != {1})
+        throw std::invalid_argument("{0}Roi needs {1} values");
+      auto& reduction = {2}::reductions(dev).{3};
+      auto roi = reduction.roi();
+      std::copy(arg, arg + {1}, roi.begin());
+      reduction.set_roi(roi);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+  }}
+}};
+)";
+
+constexpr char const* REDUCTION_FACTOR_CLASS_TEMPLATE = R"(
+class {0}{1}Attrib : public Tango::Attr
+{{
+public:
+  {0}{1}Attrib()
+  : Tango::Attr("{0}{1}", Tango::DEV_ULONG, Tango::READ_WRITE) {{}}
+  ~{0}{1}Attrib() final = default;
+{4}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{5}
+    read_value = {2}::reductions(dev).{3}.factor();
+    attr.set_value(&read_value);
+  }}
+
+  void write(Tango::DeviceImpl* dev, Tango::WAttribute& attr) final
+  {{
+    Tango::DevULong arg{{}};
+    attr.get_write_value(arg);
+    try
+    {{
+      {2}::reductions(dev).{3}.set_factor(arg);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+  }}
+}};
+)";
+
+constexpr char const* SHARED_MEMORY_CLASSES_TEMPLATE = R"(
+class {0}SegmentAttrib : public Tango::Attr
+{{
+public:
+  {0}SegmentAttrib()
+  : Tango::Attr("{0}Segment", Tango::DEV_STRING, Tango::READ) {{}}
+  ~{0}SegmentAttrib() final = default;
+{3}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{4}
+    auto const& ring = {1}::frame_rings(dev).{2};
+    if (!ring.is_open())
+    {{
+      attr.set_quality(Tango::ATTR_INVALID);
+      return;
+    }}
+    // The name lives as long as the ring
+    read_value = const_cast<char*>(ring.name().c_str());
+    attr.set_value(&read_value);
+  }}
+}};
+
+class {0}FrameAttrib : public Tango::SpectrumAttr
+{{
+public:
+  {0}FrameAttrib()
+  : Tango::SpectrumAttr("{0}Frame", Tango::DEV_LONG64, Tango::READ, 4) {{}}
+  ~{0}FrameAttrib() final = default;
+{5}
+  void read(Tango::DeviceImpl* dev, Tango::Attribute& attr) final
+  {{{6}
+    auto latest = {1}::frame_rings(dev).{2}.latest();
+    if (latest.frame == 0)
+    {{
+      // Nothing was published yet
+      attr.set_quality(Tango::ATTR_INVALID);
+      return;
+    }}
+    read_value = {{static_cast<Tango::DevLong64>(latest.slot), static_cast<Tango::DevLong64>(latest.frame),
+      static_cast<Tango::DevLong64>(latest.width), static_cast<Tango::DevLong64>(latest.height)}};
+    attr.set_value(read_value.data(), read_value.size());
+  }}
+}};
+)";
+
+std::string shared_memory_attribute_classes(std::string const& ds_name, attribute const& input, serialization_t serialization)
+{
+  auto concurrent_reads = has_concurrent_reads(serialization);
+  auto descriptor_type = "std::array<Tango::DevLong64, 4>"s;
+  return fmt::format(SHARED_MEMORY_CLASSES_TEMPLATE, input.name.camel_cased(), ds_name, input.name.snake_cased(),
+    read_buffer_member("Tango::DevString", concurrent_reads), read_buffer_local("Tango::DevString", concurrent_reads),
+    read_buffer_member(descriptor_type, concurrent_reads), read_buffer_local(descriptor_type, concurrent_reads));
+}
+
+// Images are binned, spectrums are decimated
+char const* reduction_factor_name(attribute const& input)
+{
+  return input.type.rank == attribute_rank_t::image ? "Binning" : "Decimation";
+}
+
+std::string reduction_attribute_classes(std::string const& ds_name, attribute const& input, serialization_t serialization)
+{
+  auto concurrent_reads = has_concurrent_reads(serialization);
+  auto roi_size = input.type.rank == attribute_rank_t::image ? 4 : 2;
+  auto roi_type = fmt::format("std::array<Tango::DevULong, {0}>", roi_size);
+  auto name = input.name.camel_cased();
+  auto snake_name = input.name.snake_cased();
+  return fmt::format(REDUCTION_ROI_CLASS_TEMPLATE, name, roi_size, ds_name, snake_name,
+      read_buffer_member(roi_type, concurrent_reads), read_buffer_local(roi_type, concurrent_reads))
+    + fmt::format(REDUCTION_FACTOR_CLASS_TEMPLATE, name, reduction_factor_name(input), ds_name, snake_name,
+      read_buffer_member("Tango::DevULong", concurrent_reads), read_buffer_local("Tango::DevULong", concurrent_reads));
+}
+
 std::string build_base_class(device_server_spec const& spec)
 {
   // Build the members for the base class
@@ -350,11 +692,42 @@ std::string build_base_class(device_server_spec const& spec)
     str << "\n  // attributes\n";
     for (auto const& each : spec.attributes)
     {
-      if (is_readable(each.access))
+      if (has_shared_memory(each))
+      {
+        str << fmt::format("  // also copies the frame to the shared memory ring, so only one thread may publish at a time\n"
+          "  void publish_{0}({1});\n", each.name.snake_cased(), cpp_parameter_list(each.type));
+      }
+      else if (each.source == source_t::snapshot)
+      {
+        str << fmt::format("  void publish_{0}({1}) {{ snapshots_.{0}.publish(rhs); }}\n", each.name.snake_cased(), cpp_parameter_list(each.type));
+      }
+      else if (is_readable(each.access) && each.read_mode == read_mode_t::in_place)
+      {
+        str << fmt::format("  virtual void read_{1}({0}& value) = 0;\n", cpp_type(each.type), each.name.snake_cased());
+      }
+      else if (is_readable(each.access) && each.read_mode == read_mode_t::view)
+      {
+        str << fmt::format("  // contiguous views are handed to tango directly, and their owner may be held until the calling thread reads this\n"
+          "  // attribute again. With one thread per client, do not hand out frames from a small fixed pool then.\n"
+          "  // strided views are gathered row by row and released right away.\n"
+          "  virtual image_view<{0} const> read_{1}() = 0;\n", cpp_type(each.type.type, false), each.name.snake_cased());
+      }
+      else if (is_refreshed(each))
+      {
+        str << fmt::format("  // called every {2}ms from a shared background thread, outside of tango's serialization.\n"
+          "  // It can run concurrently with the other methods of this device, so guard the state they share.\n"
+          "  virtual {0} read_{1}() = 0;\n",
+          cpp_type(each.type), each.name.snake_cased(), each.refresh_ms);
+      }
+      else if (is_readable(each.access))
       {
         str << fmt::format("  virtual {0} read_{1}() = 0;\n", cpp_type(each.type), each.name.snake_cased());
       }
-      if (is_writable(each.access))
+      if (is_writable(each.access) && each.write_mode == write_mode_t::view)
+      {
+        str << fmt::format("  virtual void write_{0}({1}) = 0;\n", each.name.snake_cased(), cpp_view_parameter_list(each.type));
+      }
+      else if (is_writable(each.access))
       {
         str << fmt::format("  virtual void write_{0}({1}) = 0;\n", each.name.snake_cased(), cpp_parameter_list(each.type));
       }
@@ -366,11 +739,181 @@ std::string build_base_class(device_server_spec const& spec)
     str << "\n  // commands\n";
     for (auto const& each : spec.commands)
     {
+      if (each.return_mode == return_mode_t::in_place)
+      {
+        auto output = fmt::format("output_array<{0}>& result", cpp_type(each.return_type.type, false));
+        auto parameters = each.parameter_type.type == value_type::void_t ? output
+          : fmt::format("{0}, {1}", cpp_parameter_list(each.parameter_type), output);
+        str << fmt::format("  virtual void {0}({1}) = 0;\n", each.name.snake_cased(), parameters);
+        continue;
+      }
       str << fmt::format("  virtual {0} {1}({2}) = 0;\n", cpp_type(each.return_type), each.name.snake_cased(), cpp_parameter_list(each.parameter_type));
     }
   }
 
-  return fmt::format(BASE_CLASS_TEMPLATE, spec.base_name, spec.device_properties_name, str.str());
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), [](attribute const& each) { return each.data_ready; }))
+  {
+    str << "\n  // data ready events, the sequence should increase with every new value, e.g. a frame number\n";
+    for (auto const& each : spec.attributes)
+    {
+      if (each.data_ready)
+        str << fmt::format("  void notify_{0}_ready(std::int32_t sequence);\n", each.name.snake_cased());
+    }
+  }
+
+  std::ostringstream private_members;
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), has_snapshot))
+  {
+    private_members << "\n\n  struct\n  {\n";
+    for (auto const& each : spec.attributes)
+    {
+      if (has_snapshot(each))
+        private_members << fmt::format("    hula::snapshot<{0}> {1};\n", cpp_type(each.type), each.name.snake_cased());
+    }
+    private_members << "  } snapshots_;";
+  }
+
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), has_events))
+  {
+    str << "\n  // events, filtered against the thresholds before they are pushed\n";
+    private_members << "\n\n  struct\n  {\n";
+    for (auto const& each : spec.attributes)
+    {
+      if (!has_events(each))
+        continue;
+
+      str << fmt::format("  void push_{0}({1});\n", each.name.snake_cased(), cpp_parameter_list(each.type));
+      auto abs_change = each.abs_change.empty() ? "0"s : each.abs_change;
+      auto rel_change = each.rel_change.empty() ? "0"s : each.rel_change;
+      for (auto [enabled, kind] : {std::make_pair(each.events.change, "change"), std::make_pair(each.events.archive, "archive")})
+      {
+        if (!enabled)
+          continue;
+        private_members << fmt::format("    hula::event_filter<{0}> {1}_{2}{{{3}, {4}}};\n",
+          cpp_type(each.type), each.name.snake_cased(), kind, abs_change, rel_change);
+      }
+    }
+    private_members << "  } event_filters_;";
+    private_members << "\n  // guards the filters when tango does not serialize the pushes\n  std::mutex event_filters_mutex_;";
+  }
+
+  std::ostringstream types;
+  if (spec.group_factory)
+  {
+    types << fmt::format("  // creates one implementation per device, in the order of the properties. On startup these are all devices of\n"
+      "  // the class, when a single device is reinitialized just that one. The context belongs to the class and is handed\n"
+      "  // to every call, e.g. to share a connection: it starts empty and keeps what the factory stores. Calls never overlap.\n"
+      "  using group_factory_type = std::function<std::vector<std::unique_ptr<{0}>>(std::vector<{1}> const& properties,\n"
+      "    std::shared_ptr<void>& context)>;\n",
+      spec.base_name, spec.device_properties_name);
+  }
+  if (spec.batched_reads)
+  {
+    std::size_t count = 0;
+    types << "\n  // identifies the attributes in a batched read\n  enum class attribute_id\n  {\n";
+    for (auto const& each : spec.attributes)
+    {
+      if (!is_read_on_request(each))
+        continue;
+      types << fmt::format("    {0},\n", each.name.snake_cased());
+      ++count;
+    }
+    types << fmt::format("  }};\n  using attribute_set = hula::attribute_set<attribute_id, {0}>;\n", count);
+
+    str << "\n  // batched hardware access, called once per client request before the attributes are read\n";
+    str << "  virtual void read_attributes(attribute_set const& requested) = 0;\n";
+  }
+
+  return fmt::format(BASE_CLASS_TEMPLATE, spec.base_name, spec.device_properties_name, str.str(), types.str(),
+    private_members.str());
+}
+
+constexpr char const* PUSH_EVENT_FUNCTION_TEMPLATE = R"(
+void hula::{0}::push_{1}({2})
+{{
+  if (context_ == nullptr)
+    return;
+
+  auto device = context_->device();
+  Tango::AutoTangoMonitor guard(device);{9}
+  auto const push_change = {3};
+  auto const push_archive = {4};
+  if (!push_change && !push_archive)
+    return;
+
+  {5} value{{}};
+  to_tango<{6}>::assign(value, rhs);
+  if (push_change)
+    device->push_change_event("{7}", {8});
+  if (push_archive)
+    device->push_archive_event("{7}", {8});
+}}
+)";
+
+// Frames published before the device is attached only go to the snapshot
+constexpr char const* PUBLISH_SHARED_FUNCTION_TEMPLATE = R"(
+void hula::{0}::publish_{1}({2})
+{{
+  snapshots_.{1}.publish(rhs);
+  if (context_ == nullptr)
+    return;
+
+  auto& ring = {3}::frame_rings(context_->device()).{1};
+  if (ring.is_open())
+    ring.write(rhs.data.data(), rhs.width, rhs.height);
+}}
+)";
+
+constexpr char const* NOTIFY_READY_FUNCTION_TEMPLATE = R"(
+void hula::{0}::notify_{1}_ready(std::int32_t sequence)
+{{
+  if (context_ == nullptr)
+    return;
+
+  auto device = context_->device();
+  Tango::AutoTangoMonitor guard(device);
+  device->push_data_ready_event("{2}", sequence);
+}}
+)";
+
+std::string build_base_class_implementation(device_server_spec const& spec, serialization_t serialization)
+{
+  // The tango monitor does nothing without serialization, so the event filters need their own guard then
+  auto filter_guard = serialization == serialization_t::none
+    ? "\n  std::lock_guard<std::mutex> filter_lock(event_filters_mutex_);"s : ""s;
+
+  std::ostringstream str;
+  for (auto const& each : spec.attributes)
+  {
+    if (each.data_ready)
+    {
+      str << fmt::format(NOTIFY_READY_FUNCTION_TEMPLATE, spec.base_name, each.name.snake_cased(), each.name.camel_cased());
+    }
+  }
+  for (auto const& each : spec.attributes)
+  {
+    if (has_shared_memory(each))
+    {
+      str << fmt::format(PUBLISH_SHARED_FUNCTION_TEMPLATE, spec.base_name, each.name.snake_cased(),
+        cpp_parameter_list(each.type), spec.ds_name);
+    }
+  }
+  for (auto const& each : spec.attributes)
+  {
+    if (!has_events(each))
+      continue;
+
+    auto name = each.name.snake_cased();
+    auto filter = [&](bool enabled, char const* kind)
+    {
+      return enabled ? fmt::format("event_filters_.{0}_{1}.update(rhs)", name, kind) : "false"s;
+    };
+    str << fmt::format(PUSH_EVENT_FUNCTION_TEMPLATE, spec.base_name, name, cpp_parameter_list(each.type),
+      filter(each.events.change, "change"), filter(each.events.archive, "archive"),
+      read_value_type(each.type), cpp_type(each.type), each.name.camel_cased(),
+      set_value_arguments(each.type, "value"), filter_guard);
+  }
+  return str.str();
 }
 
 constexpr char const* COMMAND_CLASS_TEMPLATE = R"(
@@ -437,11 +980,39 @@ constexpr char const* COMMAND_VALUE_TO_VALUE_EXECUTE_TEMPLATE = R"(
     }}
 )";
 
-std::string command_temporary_type(command_type_t const& type)
-{
-  std::string base = tango_type(type);
-  if (type.is_array)
-  {
+constexpr char const* COMMAND_VOID_TO_ARRAY_EXECUTE_TEMPLATE = R"(
+    tango_output_array<{1}, {2}> result;
+    try
+    {{
+      impl->{0}(result);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+    return insert(result.release());
+)";
+
+constexpr char const* COMMAND_VALUE_TO_ARRAY_EXECUTE_TEMPLATE = R"(
+    {0} arg{{}};
+    extract(input, arg);
+    tango_output_array<{3}, {4}> result;
+    try
+    {{
+      impl->{2}(prepare<{1}>::argument(arg), result);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+    return insert(result.release());
+)";
+
+std::string command_temporary_type(command_type_t const& type)
+{
+  std::string base = tango_type(type);
+  if (type.is_array)
+  {
     return base + " const*";
   }
   return base;
@@ -449,6 +1020,19 @@ std::string command_temporary_type(command_type_t const& type)
 
 std::string command_execute_impl(command const& cmd)
 {
+  if (cmd.return_mode == return_mode_t::in_place)
+  {
+    auto element_type = cpp_type(cmd.return_type.type, false);
+    if (cmd.parameter_type.type == value_type::void_t)
+    {
+      return fmt::format(COMMAND_VOID_TO_ARRAY_EXECUTE_TEMPLATE, cmd.name.snake_cased(),
+        tango_type(cmd.return_type), element_type);
+    }
+    return fmt::format(COMMAND_VALUE_TO_ARRAY_EXECUTE_TEMPLATE,
+      command_temporary_type(cmd.parameter_type), cpp_type(cmd.parameter_type),
+      cmd.name.snake_cased(), tango_type(cmd.return_type), element_type);
+  }
+
   if (cmd.parameter_type.type == value_type::void_t)
   {
     if (cmd.return_type.type == value_type::void_t)
@@ -493,19 +1077,19 @@ std::string command_class(std::string const& ds_name, command const& input)
 std::string load_device_properties_impl(device_server_spec const& spec)
 {
   constexpr char const* IMPL_TEMPLATE = R"(
-    Tango::DbData property_data{{{1}}};
+    auto property_data = property_names();
     if (property_data.empty() || !Tango::Util::instance()->_UseDb)
       return {{}};
 
-    // Load property data from the database
-	  get_db_device()->get_property(property_data);
+    // Load property data from the prefetch or the database
+    if (!prefetched_properties_.take(get_name(), property_data))
+	    get_db_device()->get_property(property_data);
 
     // Write it to the struct
     {0} loaded;
-    {2}
+    {1}
     return loaded;
 )";
-  std::stringstream init_list;
   std::stringstream loader_code;
   
   constexpr char const* LOAD_TEMPLATE = R"(
@@ -518,16 +1102,285 @@ std::string load_device_properties_impl(device_server_spec const& spec)
   std::size_t index = 0;
   for (auto const& device_property : spec.device_properties)
   {
-    init_list << fmt::format("\"{0}\",", device_property.name.camel_cased());
     loader_code << fmt::format(LOAD_TEMPLATE, index++, device_property.name.snake_cased(), cpp_type(device_property.type, false));
   }
 
-  return fmt::format(IMPL_TEMPLATE, spec.device_properties_name, init_list.str(), loader_code.str());
+  return fmt::format(IMPL_TEMPLATE, spec.device_properties_name, loader_code.str());
+}
+
+std::string property_name_list(device_server_spec const& spec)
+{
+  std::stringstream init_list;
+  for (auto const& device_property : spec.device_properties)
+  {
+    init_list << fmt::format("\"{0}\",", device_property.name.camel_cased());
+  }
+  return init_list.str();
+}
+
+std::string read_attr_hardware_impl(device_server_spec const& spec)
+{
+  constexpr char const* IMPL_TEMPLATE = R"(
+  void read_attr_hardware(std::vector<long>& attr_list) final
+  {{
+    {0}::attribute_set requested;
+    for (auto index : attr_list)
+    {{
+      auto const& name = dev_attr->get_attr_by_ind(index).get_name();
+      {1}
+    }}
+    if (requested.empty())
+      return;
+
+    try
+    {{
+      get(this)->read_attributes(requested);
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+  }}
+)";
+  std::vector<attribute> readable;
+  std::copy_if(spec.attributes.begin(), spec.attributes.end(), std::back_inserter(readable),
+    is_read_on_request);
+
+  auto lookup = join_applied(readable, "\n      else ", [&](attribute const& each)
+  {
+    return fmt::format("if (name == \"{0}\")\n        requested.insert({1}::attribute_id::{2});",
+      each.name.camel_cased(), spec.base_name, each.name.snake_cased());
+  });
+  return fmt::format(IMPL_TEMPLATE, spec.base_name, lookup);
+}
+
+// Whether the device class creates the adaptors first and hands them their implementations later
+bool uses_deferred_init(device_server_spec const& spec)
+{
+  return spec.parallel_init > 0 || spec.group_factory;
+}
+
+std::string refresh_impl(device_server_spec const& spec)
+{
+  constexpr char const* REFRESH_TEMPLATE = R"(
+  ~{0}() final
+  {{
+    stop_refresh();
+  }}
+
+  void start_refresh()
+  {{
+    auto impl = impl_.get();
+    auto& scheduler = shared_refresh_scheduler();{1}
+  }}
+
+  void stop_refresh()
+  {{
+    for (auto job : refresh_jobs_)
+      shared_refresh_scheduler().cancel(job);
+    refresh_jobs_.clear();
+  }}
+)";
+
+  constexpr char const* START_JOB_TEMPLATE = R"(
+    refresh_jobs_.push_back(scheduler.add(std::chrono::milliseconds({0}), [this, impl]
+    {{
+      // A failed refresh makes the attribute invalid until the next one succeeds
+      auto& snapshot = adaptor_access::snapshots(*impl).{1};
+      try
+      {{
+        snapshot.publish(impl->read_{1}());
+      }}
+      catch (std::exception const& e)
+      {{
+        ERROR_STREAM << "Refreshing {1} failed: " << e.what() << std::endl;
+        snapshot.publish_failure();
+      }}
+      catch (...)
+      {{
+        ERROR_STREAM << "Refreshing {1} failed" << std::endl;
+        snapshot.publish_failure();
+      }}
+    }}));)";
+
+  std::ostringstream jobs;
+  for (auto const& each : spec.attributes)
+  {
+    if (is_refreshed(each))
+      jobs << fmt::format(START_JOB_TEMPLATE, each.refresh_ms, each.name.snake_cased());
+  }
+  return fmt::format(REFRESH_TEMPLATE, spec.ds_name, jobs.str());
 }
 
-std::string build_adaptor_class(device_server_spec const& spec)
+std::string build_adaptor_class(device_server_spec const& spec, serialization_t serialization)
 {
-  return fmt::format(TANGO_ADAPTOR_CLASS_TEMPLATE, spec.ds_name, spec.base_name, spec.device_properties_name, load_device_properties_impl(spec));
+  std::string extra_members;
+  if (spec.batched_reads)
+  {
+    extra_members += read_attr_hardware_impl(spec);
+  }
+
+  if (uses_deferred_init(spec))
+  {
+    constexpr char const* DEFERRED_CONSTRUCTOR_TEMPLATE = R"(
+  // The device class creates the implementation later and hands it over with adopt()
+  {0}(Tango::DeviceClass* cl, char const* name, factory_type factory, deferred_init_t)
+  : TANGO_BASE_CLASS(cl, name)
+  , factory_(std::move(factory))
+  {{
+  }}
+)";
+    extra_members += fmt::format(DEFERRED_CONSTRUCTOR_TEMPLATE, spec.ds_name);
+  }
+
+  // One operating_state() serves State and Status until the cache expires or the device is reinitialized
+  std::string construct, before_init, after_init, check_state_cache, update_state_cache, private_members;
+  if (spec.state_cache_ms > 0)
+  {
+    before_init = "\n      state_cached_ = false;";
+    check_state_cache = fmt::format(R"(
+    auto now = std::chrono::steady_clock::now();
+    if (state_cached_ && now - state_time_ < std::chrono::milliseconds({0}))
+      return;)", spec.state_cache_ms);
+    update_state_cache = "\n    state_time_ = now;\n    state_cached_ = true;";
+    private_members = "\n  std::chrono::steady_clock::time_point state_time_{};\n  bool state_cached_ = false;";
+  }
+
+  // Without serialization, State and Status can be queried concurrently and need to share the cache under a lock
+  if (spec.state_cache_ms > 0 && serialization == serialization_t::none)
+  {
+    before_init = "\n      {\n        std::lock_guard<std::mutex> state_lock(state_mutex_);\n        state_cached_ = false;\n      }";
+    check_state_cache = "\n    std::lock_guard<std::mutex> state_lock(state_mutex_);" + check_state_cache;
+    private_members += "\n  std::mutex state_mutex_;";
+  }
+
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), [](attribute const& each) { return each.reduction; }))
+  {
+    constexpr char const* REDUCTIONS_TEMPLATE = R"(
+  // Set by clients through the companion attributes of the reduced attributes
+  struct reductions_type
+  {{{1}
+  }};
+
+  static reductions_type& reductions(Tango::DeviceImpl* device)
+  {{
+    return static_cast<{0}*>(device)->reductions_;
+  }}
+)";
+    std::string members;
+    for (auto const& each : spec.attributes)
+    {
+      if (!each.reduction)
+        continue;
+      members += fmt::format("\n    {0} {1};",
+        each.type.rank == attribute_rank_t::image ? "image_reduction" : "spectrum_reduction", each.name.snake_cased());
+    }
+    extra_members += fmt::format(REDUCTIONS_TEMPLATE, spec.ds_name, members);
+    private_members += "\n  reductions_type reductions_;";
+  }
+
+  // The rings are opened before any implementation can publish to them, and outlive reinitialization
+  // so clients keep their mapping
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), has_shared_memory))
+  {
+    constexpr char const* FRAME_RINGS_TEMPLATE = R"(
+  // Shared memory rings of the attributes that publish their frames there
+  struct frame_rings_type
+  {{{1}
+  }};
+
+  static frame_rings_type& frame_rings(Tango::DeviceImpl* device)
+  {{
+    return static_cast<{0}*>(device)->frame_rings_;
+  }}
+
+  void open_frame_rings()
+  {{{2}
+  }}
+)";
+    constexpr char const* OPEN_RING_TEMPLATE = R"(
+    frame_rings_.{0}.open(shm::segment_name(get_name(), "{0}"), shm::default_slot_count, sizeof({1}), {2});)";
+    std::string members, open;
+    for (auto const& each : spec.attributes)
+    {
+      if (!has_shared_memory(each))
+        continue;
+      members += fmt::format("\n    shm::ring_writer {0};", each.name.snake_cased());
+      open += fmt::format(OPEN_RING_TEMPLATE, each.name.snake_cased(), cpp_type(each.type.type, false),
+        std::uint64_t{each.type.max_size[0]} * each.type.max_size[1]);
+    }
+    extra_members += fmt::format(FRAME_RINGS_TEMPLATE, spec.ds_name, members, open);
+    private_members += "\n  frame_rings_type frame_rings_;";
+    construct += "\n    open_frame_rings();";
+  }
+
+  // Refresh jobs use the implementation, so they have to stop before it is replaced or destroyed
+  if (std::any_of(spec.attributes.begin(), spec.attributes.end(), is_refreshed))
+  {
+    before_init += "\n      stop_refresh();";
+    after_init += "\n    start_refresh();";
+    extra_members += refresh_impl(spec);
+    private_members += "\n  std::vector<refresh_scheduler::job_id> refresh_jobs_;";
+  }
+
+  // Lazy devices create their implementation on first access and can report a fixed state until then
+  std::string create_impl = "\n      adopt(factory_(load_device_properties()));";
+  std::string ensure_initialized = "\n    return self->impl_.get();";
+  if (spec.lazy_init)
+  {
+    // impl_ is only touched under lazy_mutex_, since any thread might be the first to access the device
+    constexpr char const* LAZY_INIT_TEMPLATE = R"(
+  {0}* ensure_initialized()
+  {{
+    std::lock_guard<std::mutex> lock(lazy_mutex_);
+    if (!impl_)
+    {{
+      try
+      {{
+        adopt(factory_(load_device_properties()));
+      }}
+      catch(...)
+      {{
+        convert_exception();
+      }}
+    }}
+    return impl_.get();
+  }}
+
+  bool initialized()
+  {{
+    std::lock_guard<std::mutex> lock(lazy_mutex_);
+    return impl_ != nullptr;
+  }}
+)";
+    before_init = "\n      std::lock_guard<std::mutex> lazy_lock(lazy_mutex_);" + before_init;
+    create_impl = "\n      // Created on first access";
+    ensure_initialized = "\n    return self->ensure_initialized();";
+    extra_members += fmt::format(LAZY_INIT_TEMPLATE, spec.base_name);
+    private_members += "\n  std::mutex lazy_mutex_;";
+    if (spec.lazy_init_state)
+    {
+      constexpr char const* LAZY_STATE_TEMPLATE = R"(
+    if (!initialized())
+    {{
+      set_state({0});
+      set_status("Not initialized until first access");
+      return;
+    }})";
+      check_state_cache = fmt::format(LAZY_STATE_TEMPLATE,
+        *spec.lazy_init_state == lazy_init_state_t::init ? "Tango::INIT" : "Tango::UNKNOWN") + check_state_cache;
+    }
+  }
+
+  std::string alarm_scan;
+  if (spec.alarm_scan)
+  {
+    alarm_scan = "\n\t  if (state!=Tango::ALARM)\n\t\t  Tango::DeviceImpl::dev_state();";
+  }
+
+  return fmt::format(TANGO_ADAPTOR_CLASS_TEMPLATE, spec.ds_name, spec.base_name, spec.device_properties_name,
+    load_device_properties_impl(spec), extra_members, after_init, check_state_cache, update_state_cache,
+    alarm_scan, private_members, before_init, create_impl, ensure_initialized, property_name_list(spec), construct);
 }
 
 std::string set_default_properties_impl(device_server_spec const& spec)
@@ -548,6 +1401,18 @@ std::string set_default_properties_impl(device_server_spec const& spec)
   return str.str();
 }
 
+// Attributes that hula generates next to a user attribute
+constexpr char const* CREATE_COMPANION_ATTRIBUTE_TEMPLATE = R"(
+    {{
+      auto companion = new {0}Attrib();
+      Tango::UserDefaultAttrProp properties{{}};
+      properties.set_description("{1}");
+      companion->set_default_properties(properties);
+      companion->set_disp_level({2});
+      attributes.push_back(companion);
+    }}
+)";
+
 std::string build_attribute_factory_snippet(attribute const& attribute)
 {
   constexpr char const* CREATE_ATTRIBUTE_TEMPLATE = R"(
@@ -555,7 +1420,7 @@ std::string build_attribute_factory_snippet(attribute const& attribute)
       auto {0} = new {1}Attrib();
       Tango::UserDefaultAttrProp properties{{}};{2}
       {0}->set_default_properties(properties);
-      {0}->set_disp_level({3});
+      {0}->set_disp_level({3});{4}
       attributes.push_back({0});
     }}
 )";
@@ -567,6 +1432,8 @@ std::string build_attribute_factory_snippet(attribute const& attribute)
     {"set_unit", attribute.unit},
     {"set_min_value", attribute.min_value},
     {"set_max_value", attribute.max_value},
+    {"set_min_alarm", attribute.min_alarm},
+    {"set_max_alarm", attribute.max_alarm},
   };
   for (auto& [method_name, value] : methods_and_values)
   {
@@ -575,9 +1442,60 @@ std::string build_attribute_factory_snippet(attribute const& attribute)
     extra_properties << fmt::format("\n      properties.{0}(\"{1}\");", method_name, value);
   }
 
-  return fmt::format(CREATE_ATTRIBUTE_TEMPLATE, variable_name, attribute.name.camel_cased(), extra_properties.str(),
-    tango_display_level(attribute.display_level));
+  std::ostringstream extra_settings;
+  if (attribute.polling_period_ms > 0)
+  {
+    extra_settings << fmt::format("\n      {0}->set_polling_period({1});", variable_name, attribute.polling_period_ms);
+  }
+  if (attribute.data_ready)
+  {
+    extra_settings << fmt::format("\n      {0}->set_data_ready_event(true);", variable_name);
+  }
+
+  // Events are pushed by the implementation and filtered by hula, so tango does not need to detect them
+  std::tuple<bool, char const*, char const*> events[] = {
+    {attribute.events.change, "set_change_event", "set_event"},
+    {attribute.events.archive, "set_archive_event", "set_archive_event"},
+  };
+  for (auto& [enabled, method_name, property_prefix] : events)
+  {
+    if (!enabled)
+      continue;
+    extra_settings << fmt::format("\n      {0}->{1}(true, false);", variable_name, method_name);
+    if (!attribute.abs_change.empty())
+      extra_properties << fmt::format("\n      properties.{0}_abs_change(\"{1}\");", property_prefix, attribute.abs_change);
+    if (!attribute.rel_change.empty())
+      extra_properties << fmt::format("\n      properties.{0}_rel_change(\"{1}\");", property_prefix, attribute.rel_change);
+  }
+
+  auto result = fmt::format(CREATE_ATTRIBUTE_TEMPLATE, variable_name, attribute.name.camel_cased(), extra_properties.str(),
+    tango_display_level(attribute.display_level), extra_settings.str());
+
+  if (attribute.reduction)
+  {
+    auto name = attribute.name.camel_cased();
+    auto is_image = attribute.type.rank == attribute_rank_t::image;
+    auto roi_description = is_image
+      ? fmt::format("x, y, width and height of the part of {0} that is read. A zero size extends to the edge.", name)
+      : fmt::format("Offset and length of the part of {0} that is read. A zero length extends to the end.", name);
+    auto factor_description = is_image
+      ? fmt::format("Size of the square blocks that are averaged into one pixel of {0}", name)
+      : fmt::format("Only every n-th value of {0} is read", name);
+    auto display_level = tango_display_level(attribute.display_level);
+    result += fmt::format(CREATE_COMPANION_ATTRIBUTE_TEMPLATE, name + "Roi", roi_description, display_level);
+    result += fmt::format(CREATE_COMPANION_ATTRIBUTE_TEMPLATE, name + reduction_factor_name(attribute), factor_description, display_level);
+  }
 
+  if (has_shared_memory(attribute))
+  {
+    auto name = attribute.name.camel_cased();
+    auto display_level = tango_display_level(attribute.display_level);
+    result += fmt::format(CREATE_COMPANION_ATTRIBUTE_TEMPLATE, name + "Segment",
+      fmt::format("Shared memory segment with the frames of {0}, for clients on the same host", name), display_level);
+    result += fmt::format(CREATE_COMPANION_ATTRIBUTE_TEMPLATE, name + "Frame",
+      fmt::format("Slot, frame number, width and height of the latest frame of {0} in the shared memory segment", name), display_level);
+  }
+  return result;
 }
 
 std::string build_device_class(device_server_spec const& spec)
@@ -588,16 +1506,103 @@ std::string build_device_class(device_server_spec const& spec)
     attribute_factory_impl << build_attribute_factory_snippet(attribute);
   }
   constexpr char const* CREATE_COMMAND_TEMPLATE = R"(command_list.push_back(new {0}Command());)";
+  constexpr char const* CREATE_POLLED_COMMAND_TEMPLATE = R"({{
+      auto command = new {0}Command();
+      command->set_polling_period({1});
+      command_list.push_back(command);
+    }})";
 
   auto command_factory_impl = join_applied(spec.commands, "\n    ", [&](command const& each)
   {
+    if (each.polling_period_ms > 0)
+      return fmt::format(CREATE_POLLED_COMMAND_TEMPLATE, each.name.camel_cased(), each.polling_period_ms);
     return fmt::format(CREATE_COMMAND_TEMPLATE, each.name.camel_cased());
   });
 
+  // Properties are loaded one device after the other, only the user factories run in parallel
+  constexpr char const* DEFERRED_INIT_TEMPLATE = R"(
+    std::vector<{0}*> created;
+    std::vector<{1}> properties;
+    for (auto i = device_list.size() - devlist_ptr->length(); i < device_list.size(); ++i)
+    {{
+      created.push_back(static_cast<{0}*>(device_list[i]));
+      properties.push_back(created.back()->load_device_properties());
+    }}
+
+    try
+    {{{2}
+      for (std::size_t i = 0; i < created.size(); ++i)
+        created[i]->adopt(std::move(impls[i]));
+    }}
+    catch(...)
+    {{
+      convert_exception();
+    }}
+)";
+  // Lazy devices load their properties when they are first accessed, which would make a prefetch stale
+  std::string prefetch;
+  if (!spec.lazy_init)
+  {
+    prefetch = fmt::format("\n    {0}::prefetched_properties_.load(*devlist_ptr, {0}::property_names());\n", spec.ds_name);
+  }
+
+  std::string create_impls;
+  if (spec.group_factory)
+  {
+    create_impls = R"(
+      auto impls = create_group(properties);)";
+  }
+  else if (spec.parallel_init > 0)
+  {
+    create_impls = fmt::format(R"(
+      auto impls = parallel_map(created.size(), {0}, [&](std::size_t i)
+      {{
+        return factory_(properties[i]);
+      }});)", spec.parallel_init);
+  }
+
+  std::string parallel_init, deferred_init;
+  if (uses_deferred_init(spec))
+  {
+    parallel_init = fmt::format(DEFERRED_INIT_TEMPLATE, spec.ds_name, spec.device_properties_name, create_impls);
+    deferred_init = ", deferred_init";
+  }
+
+  std::string group_factory_declaration, group_factory_definition;
+  if (spec.group_factory)
+  {
+    constexpr char const* GROUP_FACTORY_DECLARATION_TEMPLATE = R"(
+  using group_factory_type = {0}::group_factory_type;
+  static group_factory_type group_factory_;
+
+  // Startup and reinitialization share the context, and never call the group factory at the same time
+  static std::vector<std::unique_ptr<{0}>> create_group(std::vector<{1}> const& properties)
+  {{
+    static std::mutex mutex;
+    static std::shared_ptr<void> context;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto impls = group_factory_(properties, context);
+    if (impls.size() != properties.size())
+      throw std::length_error("The group factory has to create one implementation per device");
+    return impls;
+  }})";
+    group_factory_declaration = fmt::format(GROUP_FACTORY_DECLARATION_TEMPLATE, spec.base_name, spec.device_properties_name);
+    group_factory_definition = fmt::format("\n{0}::group_factory_type {0}::group_factory_;", spec.ds_class_name);
+  }
+
+  // A poll_ring_depth from the database wins over the one from the spec
+  std::string poll_ring_depth;
+  if (spec.poll_ring_depth > 0)
+  {
+    poll_ring_depth = fmt::format("\n\t\t  if (!has_database_property(dev, \"poll_ring_depth\"))\n\t\t\t  dev->set_poll_ring_depth({0});",
+      spec.poll_ring_depth);
+  }
+
   return fmt::format(TANGO_ADAPTOR_DEVICE_CLASS_CLASS_TEMPLATE,
     spec.ds_class_name, spec.ds_name, attribute_factory_impl.str(),
     command_factory_impl, set_default_properties_impl(spec),
-    spec.name.camel_cased(), spec.grouping_namespace_name);
+    spec.name.camel_cased(), spec.grouping_namespace_name, poll_ring_depth, parallel_init, deferred_init, prefetch,
+    group_factory_declaration, group_factory_definition);
 }
 
 std::string build_class_factory(std::vector<device_server_spec> const& spec_list)
@@ -610,16 +1615,63 @@ void Tango::DServer::class_factory()
 )";
   auto body = join_applied(spec_list, "\n", [](device_server_spec const& spec)
   {
-    return fmt::format("  add_class({0}::create());", spec.ds_class_name);
+    return fmt::format("  add_class(hula::create_{0}_class());", spec.name.snake_cased());
   });
   return fmt::format(CLASS_FACTORY_TEMPLATE, body);
 }
 
+char const* factory_type_name(device_server_spec const& spec)
+{
+  return spec.group_factory ? "group_factory_type" : "factory_type";
+}
+
+// The entry points into the device classes, which can live in another translation unit
+std::string build_class_declarations(std::vector<device_server_spec> const& spec_list)
+{
+  std::ostringstream str;
+  str << "\nnamespace hula {\n\n";
+  for (auto const& spec : spec_list)
+  {
+    str << fmt::format("void set_{0}_factory({1}::{2} factory);\n", spec.name.snake_cased(), spec.base_name, factory_type_name(spec));
+    str << fmt::format("Tango::DeviceClass* create_{0}_class();\n", spec.name.snake_cased());
+  }
+  str << "\n} // hula\n";
+  return str.str();
+}
+
+std::string build_class_functions(device_server_spec const& spec)
+{
+  constexpr char const* CLASS_FUNCTIONS_TEMPLATE = R"(
+void hula::set_{0}_factory({1}::{2} factory)
+{{{3}
+}}
+
+Tango::DeviceClass* hula::create_{0}_class()
+{{
+  return {4}::create();
+}}
+)";
+
+  // Devices of a group are reinitialized one by one, with the context of the whole group
+  constexpr char const* GROUP_FACTORY_ASSIGNMENT_TEMPLATE = R"(
+  {0}::group_factory_ = std::move(factory);
+  {0}::factory_ = []({1} const& properties)
+  {{
+    return std::move({0}::create_group({{properties}}).front());
+  }};)";
+
+  auto assignment = spec.group_factory
+    ? fmt::format(GROUP_FACTORY_ASSIGNMENT_TEMPLATE, spec.ds_class_name, spec.device_properties_name)
+    : fmt::format("\n  {0}::factory_ = std::move(factory);", spec.ds_class_name);
+  return fmt::format(CLASS_FUNCTIONS_TEMPLATE, spec.name.snake_cased(), spec.base_name, factory_type_name(spec),
+    assignment, spec.ds_class_name);
+}
+
 std::string build_factory_parameters(std::vector<device_server_spec> const& spec_list)
 {
   return join_applied(spec_list, ",\n  ", [](device_server_spec const& spec)
   {
-    return fmt::format("{0}::factory_type make_{1}", spec.base_name, spec.name.snake_cased());
+    return fmt::format("{0}::{2} make_{1}", spec.base_name, spec.name.snake_cased(), factory_type_name(spec));
   });
 }
 
@@ -629,7 +1681,23 @@ std::string build_runner_declaration(std::vector<device_server_spec> const& spec
   return fmt::format("int register_and_run(int argc, char* argv[],\n  {0});", factory_parameters);
 }
 
-std::string build_runner(std::vector<device_server_spec> const& spec_list)
+char const* tango_serial_model(serialization_t serialization)
+{
+  switch (serialization)
+  {
+  default:
+  case serialization_t::by_device:
+    return "Tango::BY_DEVICE";
+  case serialization_t::by_class:
+    return "Tango::BY_CLASS";
+  case serialization_t::by_process:
+    return "Tango::BY_PROCESS";
+  case serialization_t::none:
+    return "Tango::NO_SYNC";
+  }
+}
+
+std::string build_runner(std::vector<device_server_spec> const& spec_list, serialization_t serialization)
 {
   constexpr char const* RUNNER_TEMPLATE = R"(
 int hula::register_and_run(int argc, char* argv[],
@@ -637,7 +1705,7 @@ int hula::register_and_run(int argc, char* argv[],
 {{
   try
   {{
-    Tango::Util *tg = Tango::Util::init(argc,argv);
+    Tango::Util *tg = Tango::Util::init(argc,argv);{2}
 
     // Register the factories
     {1}
@@ -665,9 +1733,11 @@ int hula::register_and_run(int argc, char* argv[],
   auto factory_parameters = build_factory_parameters(spec_list);
   auto factory_assignments = join_applied(spec_list, "\n    ", [](device_server_spec const& spec)
   {
-    return fmt::format("{0}::factory_ = std::move(make_{1});", spec.ds_class_name, spec.name.snake_cased());
+    return fmt::format("set_{0}_factory(std::move(make_{0}));", spec.name.snake_cased());
   });
-  return fmt::format(RUNNER_TEMPLATE, factory_parameters, factory_assignments);
+  auto serial_model = serialization == serialization_t::by_device ? ""s
+    : fmt::format("\n    tg->set_serial_model({0});", tango_serial_model(serialization));
+  return fmt::format(RUNNER_TEMPLATE, factory_parameters, factory_assignments, serial_model);
 }
 
 std::string build_device_properties_struct(device_server_spec const& spec)
@@ -710,19 +1780,78 @@ constexpr char const* HULA_HEADER_HEADER = R"(// Generated by hula. DO NOT MODIF
 #include <cstdint>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <bitset>
+#include <cmath>
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <stdexcept>
+#include <utility>
 
 namespace hula {
 
+namespace detail {
+
+// Numbers that can be copied as a block of memory, i.e. anything arithmetic except bool
+template <class T>
+struct is_plain_number : std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>
+{
+};
+
+// Element types that tango can read directly from user memory, e.g. std::int32_t and Tango::DevLong
+template <class T, class X>
+struct is_layout_compatible : std::integral_constant<bool, std::is_same<T, X>::value ||
+  (std::is_integral<T>::value && std::is_integral<X>::value &&
+    is_plain_number<T>::value && is_plain_number<X>::value &&
+    sizeof(T) == sizeof(X) && std::is_signed<T>::value == std::is_signed<X>::value)>
+{
+};
+
+template <class To, class From>
+inline To* layout_cast(From* rhs)
+{
+  static_assert(is_layout_compatible<std::remove_const_t<To>, std::remove_const_t<From>>::value,
+    "Types must have the same layout to be reinterpreted");
+  return reinterpret_cast<To*>(rhs);
+}
+
+// Copies N numbers, converting them if needed. Layout compatible types are a single memcpy,
+// conversions are a plain loop over raw pointers that the compiler can vectorize.
+template <class T, class X>
+inline void copy_elements(T* lhs, X const* rhs, std::size_t N)
+{
+  static_assert(is_plain_number<T>::value && is_plain_number<X>::value, "Can only copy plain numbers");
+  if constexpr (is_layout_compatible<T, X>::value)
+  {
+    if (N != 0)
+      std::memcpy(lhs, rhs, N * sizeof(T));
+  }
+  else
+  {
+    for (std::size_t i = 0; i < N; ++i)
+      lhs[i] = static_cast<T>(rhs[i]);
+  }
+}
+
+} // detail
+
 template <typename T>
 struct image
 {
   template <typename X>
   static image cast(image<X> const& rhs)
   {
-    std::vector<T> data;
-    auto N = rhs.data.size();
-    data.resize(rhs.data.size());
-    std::transform(rhs.data.begin(), rhs.data.end(), data.begin(), [](auto v) {return static_cast<T>(v);});
+    std::vector<T> data(rhs.data.size());
+    if constexpr (detail::is_plain_number<T>::value && detail::is_plain_number<X>::value)
+    {
+      detail::copy_elements(data.data(), rhs.data.data(), data.size());
+    }
+    else
+    {
+      std::transform(rhs.data.begin(), rhs.data.end(), data.begin(), [](auto v) {return static_cast<T>(v);});
+    }
     return image<T>{std::move(data), rhs.width, rhs.height};
   }
 
@@ -731,307 +1860,1688 @@ struct image
   std::size_t height = 0;
 };
 
-enum class device_state
+// Pixel of an image/rgb24 attribute
+struct rgb24
 {
-  on,
-  off,
-  close,
-  open,
-  insert,
-  extract,
-  moving,
-  standby,
-  fault,
-  init,
-  running,
+  std::uint8_t r = 0;
+  std::uint8_t g = 0;
+  std::uint8_t b = 0;
+};
+static_assert(sizeof(rgb24) == 3, "rgb24 pixels need to be packed for tango's encoder");
+
+// View of an image, e.g. tango's write buffer or a region of a frame. Rows start stride elements apart,
+// a stride of 0 means they are contiguous. The optional owner keeps the viewed memory alive.
+template <typename T>
+struct image_view
+{
+  std::size_t row_stride() const { return stride == 0 ? width : stride; }
+  bool is_contiguous() const { return row_stride() == width || height <= 1; }
+  T* row(std::size_t y) const { return data + y * row_stride(); }
+
+  // The region starting at x, y, sharing the memory and the owner
+  image_view region(std::size_t x, std::size_t y, std::size_t region_width, std::size_t region_height) const
+  {
+    return {row(y) + x, region_width, region_height, row_stride(), owner};
+  }
+
+  T* data = nullptr;
+  std::size_t width = 0;
+  std::size_t height = 0;
+  std::size_t stride = 0;
+  std::shared_ptr<void const> owner;
+};
+
+namespace detail {
+
+// The pixels of a view as tango's element type. Only strided views are copied, into the given buffer.
+template <class TangoT, class T>
+inline TangoT* gather(image_view<T const> const& view, std::vector<TangoT>& buffer)
+{
+  if (view.is_contiguous())
+    return layout_cast<TangoT>(const_cast<T*>(view.data));
+
+  buffer.resize(view.width * view.height);
+  for (std::size_t y = 0; y < view.height; ++y)
+    std::copy_n(layout_cast<TangoT const>(view.row(y)), view.width, buffer.data() + y * view.width);
+  return buffer.data();
+}
+
+} // detail
+
+// Non-owning view of a contiguous array, e.g. tango's write buffer
+template <typename T>
+class span
+{
+public:
+  span() = default;
+  span(T* data, std::size_t size)
+  : data_(data), size_(size) {}
+
+  T* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T* begin() const { return data_; }
+  T* end() const { return data_ + size_; }
+  T& operator[](std::size_t i) const { return data_[i]; }
+
+private:
+  T* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+class device_context;
+struct adaptor_access;
+
+namespace detail {
+
+// Event thresholds as in tango: an absolute difference or a relative one in percent
+template <class T>
+bool exceeds(T const& last, T const& value, double abs_change, double rel_change)
+{
+  if constexpr (is_plain_number<T>::value)
+  {
+    auto delta = std::abs(static_cast<double>(value) - static_cast<double>(last));
+    if (abs_change <= 0. && rel_change <= 0.)
+      return delta != 0.;
+    if (abs_change > 0. && delta >= abs_change)
+      return true;
+    if (rel_change > 0. && last == T{})
+      return delta != 0.;
+    return rel_change > 0. && delta * 100. / std::abs(static_cast<double>(last)) >= rel_change;
+  }
+  else
+  {
+    return !(last == value);
+  }
+}
+
+template <class T>
+bool exceeds(std::vector<T> const& last, std::vector<T> const& value, double abs_change, double rel_change)
+{
+  if (last.size() != value.size())
+    return true;
+  for (std::size_t i = 0, ie = value.size(); i < ie; ++i)
+  {
+    if (exceeds<T>(last[i], value[i], abs_change, rel_change))
+      return true;
+  }
+  return false;
+}
+
+template <class T>
+bool exceeds(image<T> const& last, image<T> const& value, double abs_change, double rel_change)
+{
+  if (last.width != value.width || last.height != value.height)
+    return true;
+  return exceeds(last.data, value.data, abs_change, rel_change);
+}
+
+} // detail
+
+// Remembers the last pushed value of an attribute to decide whether a new one is worth an event
+template <typename T>
+class event_filter
+{
+public:
+  event_filter(double abs_change, double rel_change)
+  : abs_change_(abs_change), rel_change_(rel_change) {}
+
+  bool update(T const& value)
+  {
+    if (has_last_ && !detail::exceeds(last_, value, abs_change_, rel_change_))
+      return false;
+    last_ = value;
+    has_last_ = true;
+    return true;
+  }
+
+private:
+  double abs_change_ = 0.;
+  double rel_change_ = 0.;
+  T last_{};
+  bool has_last_ = false;
+};
+
+// Hands the latest value from one publishing thread to one reading thread without locking.
+// Uses three buffers: one being written, one being read and the latest complete one in between.
+template <typename T>
+class snapshot
+{
+public:
+  void publish(T const& value)
+  {
+    buffers_[back_] = value;
+    valid_[back_] = true;
+    swap_back();
+  }
+
+  // Replaces the latest value with none, e.g. when reading the hardware failed
+  void publish_failure()
+  {
+    valid_[back_] = false;
+    swap_back();
+  }
+
+  // The latest published value, or nullptr when nothing was published yet or the last publication was a failure
+  T const* latest()
+  {
+    if (middle_.load(std::memory_order_relaxed) & FRESH)
+    {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+      has_value_ = true;
+    }
+    return has_value_ && valid_[front_] ? &buffers_[front_] : nullptr;
+  }
+
+private:
+  static constexpr unsigned INDEX = 3;
+  static constexpr unsigned FRESH = 4;
+
+  void swap_back()
+  {
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  T buffers_[3]{};
+  bool valid_[3]{};
+  std::atomic<unsigned> middle_{1};
+  unsigned back_ = 0;
+  unsigned front_ = 2;
+  bool has_value_ = false;
+};
+
+// The attributes a client requested in a single call
+template <typename Id, std::size_t N>
+class attribute_set
+{
+public:
+  void insert(Id id) { bits_.set(static_cast<std::size_t>(id)); }
+  bool contains(Id id) const { return bits_.test(static_cast<std::size_t>(id)); }
+  bool empty() const { return bits_.none(); }
+  std::size_t size() const { return bits_.count(); }
+
+private:
+  std::bitset<N> bits_;
+};
+
+// Result buffer for array commands that is handed to tango without a copy
+template <typename T>
+class output_array
+{
+public:
+  virtual ~output_array() = default;
+
+  // Sets the number of elements in the result and returns the memory to write them to
+  virtual span<T> resize(std::size_t size) = 0;
+};
+
+// A requested extent of zero means everything that is available
+inline std::size_t reduced_extent(std::uint32_t requested, std::size_t available)
+{
+  return requested == 0 ? available : std::min<std::size_t>(requested, available);
+}
+
+// Region of interest and binning or decimation factor of a reduced attribute
+template <std::size_t N>
+class reduction_settings
+{
+public:
+  using roi_type = std::array<std::uint32_t, N>;
+
+  roi_type roi() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return roi_;
+  }
+
+  void set_roi(roi_type const& rhs)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    roi_ = rhs;
+  }
+
+  std::uint32_t factor() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return factor_;
+  }
+
+  void set_factor(std::uint32_t rhs)
+  {
+    if (rhs == 0)
+      throw std::invalid_argument("The reduction factor needs to be at least 1");
+    std::lock_guard<std::mutex> lock(mutex_);
+    factor_ = rhs;
+  }
+
+protected:
+  std::pair<roi_type, std::size_t> current() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {roi_, factor_};
+  }
+
+private:
+  mutable std::mutex mutex_;
+  roi_type roi_{};
+  std::uint32_t factor_ = 1;
+};
+
+// Wide enough to sum a block of pixels without overflowing
+template <class T>
+using reduction_sum_t = std::conditional_t<std::is_floating_point<T>::value, double,
+  std::conditional_t<std::is_signed<T>::value, std::int64_t, std::uint64_t>>;
+
+// The roi is x, y, width and height, the factor is the size of the square blocks that are averaged into one pixel
+class image_reduction : public reduction_settings<4>
+{
+public:
+  template <class T>
+  void apply(image<T> const& source, image<T>& target) const
+  {
+    auto [roi, bin] = current();
+    if (source.width == 0 || source.height == 0)
+    {
+      target = {};
+      return;
+    }
+    if (roi[0] >= source.width || roi[1] >= source.height)
+      throw std::invalid_argument("The region of interest starts outside of the image");
+
+    std::size_t x = roi[0];
+    std::size_t y = roi[1];
+    auto width = reduced_extent(roi[2], source.width - x);
+    auto height = reduced_extent(roi[3], source.height - y);
+    if (bin > width || bin > height)
+      throw std::invalid_argument("The binning factor is larger than the region of interest");
+
+    target.width = width / bin;
+    target.height = height / bin;
+    target.data.resize(target.width * target.height);
+    auto* out = target.data.data();
+    if (bin == 1)
+    {
+      for (std::size_t row = 0; row < target.height; ++row)
+        std::copy_n(source.data.data() + (y + row) * source.width + x, target.width, out + row * target.width);
+      return;
+    }
+
+    // The bin rows of a block are first summed element by element, which reads and writes contiguously and
+    // vectorizes. Only then are bin neighbours of the summed row added up.
+    using sum_type = reduction_sum_t<T>;
+    static thread_local std::vector<sum_type> sums;
+    auto const used_width = target.width * bin;
+    sums.resize(used_width);
+    auto const count = static_cast<sum_type>(bin * bin);
+    for (std::size_t row = 0; row < target.height; ++row)
+    {
+      std::fill(sums.begin(), sums.end(), sum_type{});
+      for (std::size_t dy = 0; dy < bin; ++dy)
+      {
+        auto const* in = source.data.data() + (y + row * bin + dy) * source.width + x;
+        for (std::size_t i = 0; i < used_width; ++i)
+          sums[i] += in[i];
+      }
+      for (std::size_t column = 0; column < target.width; ++column)
+      {
+        sum_type sum{};
+        for (std::size_t dx = 0; dx < bin; ++dx)
+          sum += sums[column * bin + dx];
+        out[row * target.width + column] = static_cast<T>(sum / count);
+      }
+    }
+  }
+};
+
+// The roi is offset and length, the factor keeps only every n-th value
+class spectrum_reduction : public reduction_settings<2>
+{
+public:
+  template <class T>
+  void apply(std::vector<T> const& source, std::vector<T>& target) const
+  {
+    auto [roi, step] = current();
+    auto offset = std::min<std::size_t>(roi[0], source.size());
+    auto length = reduced_extent(roi[1], source.size() - offset);
+    auto const* in = source.data() + offset;
+    if (step == 1)
+    {
+      target.assign(in, in + length);
+      return;
+    }
+
+    target.resize((length + step - 1) / step);
+    for (std::size_t i = 0; i < target.size(); ++i)
+      target[i] = in[i * step];
+  }
+};
+
+enum class device_state
+{
+  on,
+  off,
+  close,
+  open,
+  insert,
+  extract,
+  moving,
+  standby,
+  fault,
+  init,
+  running,
   alarm,
   disable,
   unknown
 };
 
-struct operating_state_result
+struct operating_state_result
+{
+  device_state state = device_state::unknown;
+  std::string status;
+};
+)";
+
+constexpr char const* HULA_HEADER_FOOTER = R"(
+
+} // hula
+)";
+
+constexpr char const* HULA_DEVICE_HEADER_HEADER = R"(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
+#pragma once
+#include "hula_common.hpp"
+
+namespace hula {
+)";
+
+constexpr char const* HULA_UMBRELLA_HEADER = R"(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
+#pragma once
+#include "hula_common.hpp"
+)";
+
+constexpr char const* HULA_IMPLEMENTATION_INCLUDES = R"(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
+#include "hula_generated.hpp"
+#include <tango.h>
+#include <type_traits>
+#include <stdexcept>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <system_error>
+#include <condition_variable>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <array>
+)";
+
+constexpr char const* HULA_IMPLEMENTATION_HEADER = R"--(
+namespace hula {
+
+// Links an implementation to its tango device, e.g. to push events
+class device_context
+{
+public:
+  explicit device_context(Tango::DeviceImpl* device)
+  : device_(device) {}
+
+  Tango::DeviceImpl* device() const
+  {
+    return device_;
+  }
+
+private:
+  Tango::DeviceImpl* device_;
+};
+
+// Lets the generated adaptors reach the internals of the base classes
+struct adaptor_access
+{
+  template <class Base>
+  static void attach(Base& impl, device_context* context)
+  {
+    impl.context_ = context;
+  }
+
+  template <class Base>
+  static auto& snapshots(Base& impl)
+  {
+    return impl.snapshots_;
+  }
+};
+
+// Runs periodic jobs on a few threads, ordered by their due time
+class refresh_scheduler
+{
+public:
+  using job_id = std::uint64_t;
+  using clock = std::chrono::steady_clock;
+
+  explicit refresh_scheduler(std::size_t thread_count)
+  {
+    for (std::size_t i = 0; i < thread_count; ++i)
+      threads_.emplace_back([this] { run(); });
+  }
+
+  ~refresh_scheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& each : threads_)
+      each.join();
+  }
+
+  job_id add(std::chrono::milliseconds period, std::function<void()> job)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto id = next_id_++;
+    jobs_.emplace(id, std::make_shared<entry>(entry{period, std::move(job)}));
+    queue_.push({clock::now(), id});
+    wake_.notify_one();
+    return id;
+  }
+
+  // Returns once the job is not running anymore, so its captures can be destroyed afterwards
+  void cancel(job_id id)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.erase(id);
+    idle_.wait(lock, [&] { return running_.count(id) == 0; });
+  }
+
+private:
+  struct entry
+  {
+    std::chrono::milliseconds period;
+    std::function<void()> job;
+  };
+
+  struct due_job
+  {
+    clock::time_point due;
+    job_id id;
+
+    bool operator>(due_job const& rhs) const
+    {
+      return due > rhs.due;
+    }
+  };
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+      if (queue_.empty())
+      {
+        wake_.wait(lock);
+        continue;
+      }
+
+      auto next = queue_.top();
+      auto found = jobs_.find(next.id);
+      if (found == jobs_.end())
+      {
+        // Cancelled
+        queue_.pop();
+        continue;
+      }
+      if (clock::now() < next.due)
+      {
+        wake_.wait_until(lock, next.due);
+        continue;
+      }
+
+      queue_.pop();
+      auto current = found->second;
+      running_.insert(next.id);
+      lock.unlock();
+      try
+      {
+        current->job();
+      }
+      catch (...)
+      {
+        // The jobs report their own failures, this only keeps the thread alive
+      }
+      lock.lock();
+      running_.erase(next.id);
+      idle_.notify_all();
+
+      if (jobs_.count(next.id) != 0)
+      {
+        // Do not try to catch up when a job took longer than its period
+        queue_.push({std::max(next.due + current->period, clock::now()), next.id});
+        wake_.notify_one();
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::priority_queue<due_job, std::vector<due_job>, std::greater<due_job>> queue_;
+  std::unordered_map<job_id, std::shared_ptr<entry>> jobs_;
+  std::unordered_set<job_id> running_;
+  job_id next_id_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// Device properties for all devices of a class, fetched with a single database call and handed out once per device
+class property_prefetch
+{
+public:
+  void load(Tango::DevVarStringArray const& devices, Tango::DbData const& names)
+  {
+    auto util = Tango::Util::instance();
+    if (names.empty() || !util->_UseDb)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    try
+    {
+      // Tango keeps a cache of the whole server during startup. Otherwise one call fetches it.
+      auto database = util->get_database();
+      auto cache = util->get_db_cache();
+      std::unique_ptr<Tango::DbServerCache> own_cache;
+      if (cache == nullptr)
+      {
+        own_cache = std::make_unique<Tango::DbServerCache>(database, util->get_ds_name(), util->get_host_name());
+        cache = own_cache.get();
+      }
+
+      for (unsigned long i = 0; i < devices.length(); ++i)
+      {
+        char const* name = devices[i];
+        auto data = names;
+        database->get_device_property(name, data, cache);
+        loaded_[name] = std::move(data);
+      }
+    }
+    catch (...)
+    {
+      // The devices load their properties one by one instead
+      loaded_.clear();
+    }
+  }
+
+  // Moves the prefetched properties of a device into data, false when there are none
+  bool take(std::string const& device, Tango::DbData& data)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = loaded_.find(device);
+    if (found == loaded_.end())
+      return false;
+
+    data = std::move(found->second);
+    loaded_.erase(found);
+    return true;
+  }
+
+private:
+  std::mutex mutex_;
+  std::map<std::string, Tango::DbData> loaded_;
+};
+
+// Whether the database has a value for a property of the device, e.g. one of tango's own like poll_ring_depth
+inline bool has_database_property(Tango::DeviceImpl* device, char const* name)
+{
+  if (!Tango::Util::_UseDb)
+    return false;
+
+  Tango::DbData data{Tango::DbDatum(name)};
+  device->get_db_device()->get_property(data);
+  return !data[0].is_empty();
+}
+
+// Selects the adaptor constructor that leaves creating the implementation to the caller
+struct deferred_init_t {};
+constexpr deferred_init_t deferred_init{};
+
+// Calls f(i) for each index on at most thread_count threads and returns the results in index order.
+// Rethrows the exception of the first failing index once all calls are done.
+template <class F>
+auto parallel_map(std::size_t count, std::size_t thread_count, F f) -> std::vector<decltype(f(std::size_t{}))>
+{
+  std::vector<decltype(f(std::size_t{}))> results(count);
+  std::vector<std::exception_ptr> errors(count);
+  std::atomic<std::size_t> next{0};
+  auto work = [&]
+  {
+    for (auto i = next++; i < count; i = next++)
+    {
+      try
+      {
+        results[i] = f(i);
+      }
+      catch (...)
+      {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  // When no more threads can be started, the ones that run and this one do the rest
+  std::vector<std::thread> threads;
+  threads.reserve(std::min(thread_count, count));
+  for (std::size_t i = 1; i < std::min(thread_count, count); ++i)
+  {
+    try
+    {
+      threads.emplace_back(work);
+    }
+    catch (std::system_error const&)
+    {
+      break;
+    }
+  }
+  work();
+  for (auto& each : threads)
+    each.join();
+
+  for (auto const& each : errors)
+  {
+    if (each)
+      std::rethrow_exception(each);
+  }
+  return results;
+}
+
+// One scheduler serves all devices of the process. It is never destroyed, since devices might outlive static storage.
+inline refresh_scheduler& shared_refresh_scheduler()
+{
+  static auto* scheduler = new refresh_scheduler(std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+  return *scheduler;
+}
+
+} // hula
+
+using namespace hula;
+
+namespace {
+template <class T>
+struct to_tango
+{
+  // This is used in commands for insert(...)
+  static T convert(T rhs)
+  {
+    return rhs;
+  }
+  // This is used to assign to read members in attributes
+  static void assign(T& lhs, T rhs)
+  {
+    lhs = rhs;
+  }
+};
+
+using detail::is_plain_number;
+using detail::is_layout_compatible;
+
+using detail::layout_cast;
+using detail::gather;
+
+template <class T, class X>
+inline void assign_to(std::vector<T>& lhs, std::vector<X> const& rhs)
+{
+  lhs.resize(rhs.size());
+  if constexpr (is_plain_number<T>::value && is_plain_number<X>::value)
+  {
+    detail::copy_elements(lhs.data(), rhs.data(), rhs.size());
+  }
+  else
+  {
+    for (std::size_t i = 0, ie = rhs.size(); i < ie; ++i)
+      lhs[i] = static_cast<T>(rhs[i]);
+  }
+}
+
+template <class TangoArray, class T>
+inline TangoArray* copied_to_tango(std::vector<T> const& rhs)
+{
+    auto result = std::make_unique<TangoArray>();
+    if (!rhs.empty())
+    {
+      std::size_t N = rhs.size();
+      result->length(N);
+      if constexpr (is_plain_number<T>::value)
+      {
+        detail::copy_elements(result->get_buffer(), rhs.data(), N);
+      }
+      else
+      {
+        for (std::size_t i = 0; i < N; ++i)
+          (*result)[i] = rhs[i];
+      }
+    }
+    return result.release();
+}
+
+// Lets commands write their array result directly to the sequence that is returned to tango
+template <class TangoArray, class T>
+class tango_output_array final : public output_array<T>
+{
+public:
+  span<T> resize(std::size_t size) final
+  {
+    result_->length(size);
+    return {layout_cast<T>(result_->get_buffer()), size};
+  }
+
+  TangoArray* release()
+  {
+    return result_.release();
+  }
+
+private:
+  std::unique_ptr<TangoArray> result_ = std::make_unique<TangoArray>();
+};
+
+template <class T>
+struct prepare
+{
+  template <class X>
+  static T argument(X v)
+  {
+    return v;
+  }
+};
+
+template <class T>
+struct prepare<std::vector<T>>
+{
+  template <class S>
+  static std::vector<T> argument(_CORBA_Unbounded_Sequence<S> const* rhs)
+  {
+    std::vector<T> result(rhs->length());
+    if constexpr (is_plain_number<T>::value && is_plain_number<S>::value)
+    {
+      detail::copy_elements(result.data(), rhs->get_buffer(), result.size());
+    }
+    else
+    {
+      for (std::size_t i = 0, ie = result.size(); i < ie; ++i)
+        result[i] = (*rhs)[i];
+    }
+    return result;
+  }
+};
+
+// std::int32_t and Tango::DevLong are not the same on some OSes, e.g. Win32.
+// Same for the other 32 and 64 bit integers, so these always convert explicitly.
+template <class T, class TangoT>
+struct converting_to_tango
+{
+  static_assert(sizeof(TangoT) == sizeof(T), "Tango type must be compatible to the C++ type");
+  static TangoT convert(T rhs)
+  {
+    return static_cast<TangoT>(rhs);
+  }
+  static void assign(TangoT& lhs, T rhs)
+  {
+    lhs = static_cast<TangoT>(rhs);
+  }
+};
+
+template <>
+struct to_tango<std::int32_t> : converting_to_tango<std::int32_t, Tango::DevLong> {};
+template <>
+struct to_tango<std::uint32_t> : converting_to_tango<std::uint32_t, Tango::DevULong> {};
+template <>
+struct to_tango<std::int64_t> : converting_to_tango<std::int64_t, Tango::DevLong64> {};
+template <>
+struct to_tango<std::uint64_t> : converting_to_tango<std::uint64_t, Tango::DevULong64> {};
+
+template <>
+struct to_tango<std::string>
+{
+  static Tango::DevString convert(std::string const& rhs)
+  {
+    return Tango::string_dup(rhs.c_str());
+  }
+
+  static void assign(Tango::DevString& lhs, std::string const& rhs)
+  {
+    lhs = Tango::string_dup(rhs.c_str());
+  }
+};
+
+// Encoding for image/8, image/16 and image/rgb24. Tango does not modify the pixels, but takes them as non-const.
+inline void encode(Tango::EncodedAttribute& lhs, image<std::uint8_t> const& rhs)
+{
+  lhs.encode_gray8(const_cast<unsigned char*>(rhs.data.data()), static_cast<int>(rhs.width), static_cast<int>(rhs.height));
+}
+
+inline void encode(Tango::EncodedAttribute& lhs, image<std::uint16_t> const& rhs)
+{
+  lhs.encode_gray16(const_cast<unsigned short*>(rhs.data.data()), static_cast<int>(rhs.width), static_cast<int>(rhs.height));
+}
+
+inline unsigned char* rgb24_bytes(image<rgb24> const& rhs)
+{
+  return reinterpret_cast<unsigned char*>(const_cast<rgb24*>(rhs.data.data()));
+}
+
+inline void encode(Tango::EncodedAttribute& lhs, image<rgb24> const& rhs)
+{
+  lhs.encode_rgb24(rgb24_bytes(rhs), static_cast<int>(rhs.width), static_cast<int>(rhs.height));
+}
+
+// Conversion for attributes with encoding = "jpeg"
+template <int Quality>
+struct jpeg_to_tango
+{
+  static void assign(Tango::EncodedAttribute& lhs, image<std::uint8_t> const& rhs)
+  {
+    lhs.encode_jpeg_gray8(const_cast<unsigned char*>(rhs.data.data()), static_cast<int>(rhs.width), static_cast<int>(rhs.height), Quality);
+  }
+
+  static void assign(Tango::EncodedAttribute& lhs, image<rgb24> const& rhs)
+  {
+    lhs.encode_jpeg_rgb24(rgb24_bytes(rhs), static_cast<int>(rhs.width), static_cast<int>(rhs.height), Quality);
+  }
+};
+
+template <class T>
+struct to_tango<image<T>>
+{
+  template <class X>
+  static void assign(image<X>& lhs, image<T> const& rhs)
+  {
+    // Reuse the buffer of the read member instead of allocating a new image on every read
+    assign_to(lhs.data, rhs.data);
+    lhs.width = rhs.width;
+    lhs.height = rhs.height;
+  }
+
+  static void assign(Tango::EncodedAttribute& lhs, image<T> const& rhs)
+  {
+    encode(lhs, rhs);
+  }
+};
+
+template <class T, class TangoArray, class TangoT>
+struct array_to_tango
+{
+  static TangoArray* convert(std::vector<T> const& rhs)
+  {
+    return copied_to_tango<TangoArray>(rhs);
+  }
+
+  static void assign(std::vector<TangoT>& lhs, std::vector<T> const& rhs)
+  {
+    assign_to(lhs, rhs);
+  }
+};
+
+template <>
+struct to_tango<std::vector<std::uint8_t>> : array_to_tango<std::uint8_t, Tango::DevVarCharArray, Tango::DevUChar> {};
+template <>
+struct to_tango<std::vector<std::int16_t>> : array_to_tango<std::int16_t, Tango::DevVarShortArray, Tango::DevShort> {};
+template <>
+struct to_tango<std::vector<std::uint16_t>> : array_to_tango<std::uint16_t, Tango::DevVarUShortArray, Tango::DevUShort> {};
+template <>
+struct to_tango<std::vector<std::int32_t>> : array_to_tango<std::int32_t, Tango::DevVarLongArray, Tango::DevLong> {};
+template <>
+struct to_tango<std::vector<std::uint32_t>> : array_to_tango<std::uint32_t, Tango::DevVarULongArray, Tango::DevULong> {};
+template <>
+struct to_tango<std::vector<std::int64_t>> : array_to_tango<std::int64_t, Tango::DevVarLong64Array, Tango::DevLong64> {};
+template <>
+struct to_tango<std::vector<std::uint64_t>> : array_to_tango<std::uint64_t, Tango::DevVarULong64Array, Tango::DevULong64> {};
+template <>
+struct to_tango<std::vector<float>> : array_to_tango<float, Tango::DevVarFloatArray, Tango::DevFloat> {};
+template <>
+struct to_tango<std::vector<double>> : array_to_tango<double, Tango::DevVarDoubleArray, Tango::DevDouble> {};
+
+template <class T>
+struct from_tango
+{
+  static void load(T& lhs, Tango::DbDatum& rhs)
+  {
+    rhs >> lhs;
+  }
+};
+
+template <class T, class TangoT>
+struct converting_from_tango
+{
+  static void load(T& lhs, Tango::DbDatum& rhs)
+  {
+    TangoT tmp{};
+    rhs >> tmp;
+    lhs = static_cast<T>(tmp);
+  }
+};
+
+template <>
+struct from_tango<std::int32_t> : converting_from_tango<std::int32_t, Tango::DevLong> {};
+template <>
+struct from_tango<std::uint32_t> : converting_from_tango<std::uint32_t, Tango::DevULong> {};
+template <>
+struct from_tango<std::int64_t> : converting_from_tango<std::int64_t, Tango::DevLong64> {};
+template <>
+struct from_tango<std::uint64_t> : converting_from_tango<std::uint64_t, Tango::DevULong64> {};
+
+
+[[noreturn]] void convert_exception()
+{
+  try
+  {
+    throw;
+  }
+  catch (Tango::DevFailed const&)
+  {
+    throw;
+  }
+  catch (std::exception const& e)
+  {
+    Tango::Except::throw_exception("STD_EXCEPTION", e.what(), "convert_exception()");
+  }
+  catch (...)
+  {
+    Tango::Except::throw_exception("UNKNOWN_EXCEPTION", "Unknown exception", "convert_exception()");
+  }
+}
+
+inline Tango::DevState convert_state(device_state s)
+{
+  // Make sure the hula definitions match up
+  static_assert(static_cast<Tango::DevState>(device_state::on)==Tango::ON, "ON does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::off)==Tango::OFF, "OFF does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::close)==Tango::CLOSE, "CLOSE does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::open)==Tango::OPEN, "OPEN does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::insert)==Tango::INSERT, "INSERT does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::extract)==Tango::EXTRACT, "EXTRACT does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::moving)==Tango::MOVING, "MOVING does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::standby)==Tango::STANDBY, "STANDBY does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::fault)==Tango::FAULT, "FAULT does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::init)==Tango::INIT, "INIT does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::running)==Tango::RUNNING, "RUNNING does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::alarm)==Tango::ALARM, "ALARM does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::disable)==Tango::DISABLE, "DISABLE does not match up");
+  static_assert(static_cast<Tango::DevState>(device_state::unknown)==Tango::UNKNOWN, "UNKNOWN does not match up");
+  return static_cast<Tango::DevState>(s);
+}
+
+)--";
+
+constexpr char const* HULA_SHM_HEADER = R"--(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
+// Shared memory rings for image attributes with shared_memory = true. This header has no tango dependency,
+// so clients on the same host can include it to map the frames instead of reading them through CORBA.
+// Needs POSIX shared memory, link with -lrt on glibc before 2.34.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hula {
+namespace shm {
+
+constexpr std::size_t default_slot_count = 4;
+
+// Where a frame is in its segment. This is what the <Name>Frame attribute returns.
+// Frame numbers start at 1, 0 means nothing was written yet.
+struct descriptor
+{
+  std::uint64_t slot = 0;
+  std::uint64_t frame = 0;
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+};
+
+// The segment of an attribute, e.g. /hula.test.camera.1.image for the attribute image of test/camera/1.
+// This is what the <Name>Segment attribute returns.
+inline std::string segment_name(std::string const& device_name, std::string const& attribute_name)
+{
+  auto result = "/hula." + device_name + "." + attribute_name;
+  std::replace(result.begin() + 1, result.end(), '/', '.');
+  return result;
+}
+
+namespace detail {
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared memory needs lock free atomics");
+
+constexpr std::uint32_t magic = 0x616c7568;
+constexpr std::uint32_t version = 2;
+constexpr std::size_t alignment = 64;
+
+// Starts the segment, the slots follow
+struct alignas(alignment) segment_header
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t slot_count;
+  std::uint32_t element_size;
+  // Bytes per slot, including its header
+  std::uint64_t slot_size;
+  std::atomic<std::uint64_t> latest_frame;
+  // The process that writes the segment, which tells a segment in use from a stale one
+  std::int32_t writer_pid;
+};
+
+// Each slot is a seqlock: its sequence is odd while the writer changes it. The pixels follow the header.
+struct alignas(alignment) slot_header
 {
-  device_state state = device_state::unknown;
-  std::string status;
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> frame;
+  std::atomic<std::uint32_t> width;
+  std::atomic<std::uint32_t> height;
 };
-)";
 
-constexpr char const* HULA_HEADER_FOOTER = R"(
+inline std::system_error last_error(std::string const& what)
+{
+  return std::system_error(errno, std::generic_category(), what);
+}
 
-} // hula
-)";
+// Owns the mapping of a whole segment
+class mapping
+{
+public:
+  mapping() = default;
+  mapping(void* data, std::size_t size)
+  : data_(data), size_(size) {}
 
-constexpr char const* HULA_IMPLEMENTATION_HEADER = R"--(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
-#include "hula_generated.hpp"
-#include <tango.h>
+  mapping(mapping&& rhs) noexcept
+  : data_(std::exchange(rhs.data_, nullptr)), size_(std::exchange(rhs.size_, 0)) {}
 
-using namespace hula;
+  mapping& operator=(mapping&& rhs) noexcept
+  {
+    std::swap(data_, rhs.data_);
+    std::swap(size_, rhs.size_);
+    return *this;
+  }
 
-namespace {
-template <class T>
-struct to_tango
-{
-  // This is used in commands for insert(...)
-  static T convert(T rhs)
+  ~mapping()
   {
-    return rhs;
+    if (data_ != nullptr)
+      munmap(data_, size_);
   }
-  // This is used to assign to read members in attributes
-  static void assign(T& lhs, T rhs)
+
+  explicit operator bool() const { return data_ != nullptr; }
+
+  segment_header* header() const { return static_cast<segment_header*>(data_); }
+
+  slot_header* slot(std::size_t index) const
   {
-    lhs = rhs;
+    auto base = static_cast<char*>(data_) + sizeof(segment_header);
+    return reinterpret_cast<slot_header*>(base + index * header()->slot_size);
   }
-};
 
-template <class T, class X>
-inline void assign_to(std::vector<T>& lhs, std::vector<X> const& rhs)
-{
-  lhs.resize(rhs.size());
-  for (std::size_t i = 0, ie = rhs.size(); i < ie; ++i)
-    lhs[i] = static_cast<T>(rhs[i]);
-}
+  static char* pixels(slot_header* slot) { return reinterpret_cast<char*>(slot) + sizeof(slot_header); }
 
-template <class TangoArray, class T>
-inline TangoArray* copied_to_tango(std::vector<T> const& rhs)
+private:
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Takes ownership of the file descriptor
+inline mapping map(int fd, std::size_t size, int protection, std::string const& name)
 {
-    auto result = std::make_unique<TangoArray>();
-    if (!rhs.empty())
-    {
-      std::size_t N = rhs.size();
-      result->length(N);
-      for (std::size_t i = 0; i < N; ++i)
-        (*result)[i] = rhs[i];
-    }
-    return result.release();
+  auto data = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+  auto error = errno;
+  close(fd);
+  if (data == MAP_FAILED)
+    throw std::system_error(error, std::generic_category(), "Cannot map shared memory " + name);
+  return {data, size};
 }
 
-template <class T>
-struct prepare
+// Throws when the segment exists and the process that wrote it still runs, e.g. a second instance of the
+// server. The segment of a process that died without removing it is left to be replaced.
+inline void check_unused(std::string const& name)
 {
-  template <class X>
-  static T argument(X v)
+  auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return;
+  struct stat status{};
+  if (fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(segment_header))
   {
-    return v;
+    ::close(fd);
+    return;
   }
-};
 
-template <class T>
-struct prepare<std::vector<T>>
+  auto existing = map(fd, sizeof(segment_header), PROT_READ, name);
+  auto header = existing.header();
+  if (header->magic != magic || header->version != version)
+    return;
+  // Our own pid was that of an earlier process, e.g. pid 1 in a restarted container
+  auto pid = static_cast<pid_t>(header->writer_pid);
+  if (pid <= 0 || pid == getpid())
+    return;
+  if (kill(pid, 0) == 0 || errno == EPERM)
+    throw std::system_error(EBUSY, std::generic_category(),
+      "Shared memory " + name + " is still written by process " + std::to_string(pid));
+}
+
+} // detail
+
+// Writes frames to a segment that it creates and removes. One thread may write at a time.
+class ring_writer
 {
-  template <class S>
-  static std::vector<T> argument(_CORBA_Unbounded_Sequence<S> const* rhs)
+public:
+  ring_writer() = default;
+  ring_writer(ring_writer const&) = delete;
+  ring_writer& operator=(ring_writer const&) = delete;
+
+  ~ring_writer()
   {
-    std::vector<T> result(rhs->length());
-    for (std::size_t i = 0, ie = result.size(); i < ie; ++i)
-      result[i] = (*rhs)[i];
-    return result;
+    close();
   }
-};
 
-// std::int32_t and Tango::DevLong are not the same on some OSes, e.g. Win32
-template <>
-struct to_tango<std::int32_t>
-{
-  static_assert(sizeof(Tango::DevLong) == sizeof(std::int32_t), "Tango::DevLong must be compatible to std::int32_t");
-  static Tango::DevLong convert(std::int32_t rhs)
+  // Creates the segment, replacing a stale one with the same name. The default mode only lets
+  // processes of the same user map the frames.
+  void open(std::string const& name, std::size_t slot_count, std::size_t element_size, std::size_t max_pixels,
+    mode_t mode = 0600)
   {
-    return static_cast<Tango::DevLong>(rhs);
+    close();
+    detail::check_unused(name);
+    shm_unlink(name.c_str());
+    auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+    if (fd < 0)
+      throw detail::last_error("Cannot create shared memory " + name);
+
+    auto slot_size = (sizeof(detail::slot_header) + element_size * max_pixels + detail::alignment - 1)
+      / detail::alignment * detail::alignment;
+    auto size = sizeof(detail::segment_header) + slot_count * slot_size;
+    try
+    {
+      if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+      {
+        auto error = detail::last_error("Cannot size shared memory " + name);
+        ::close(fd);
+        throw error;
+      }
+      // The new segment is zero filled, so all slots start with an even sequence and no frame
+      mapping_ = detail::map(fd, size, PROT_READ | PROT_WRITE, name);
+    }
+    catch (...)
+    {
+      shm_unlink(name.c_str());
+      throw;
+    }
+
+    auto header = mapping_.header();
+    header->version = detail::version;
+    header->slot_count = static_cast<std::uint32_t>(slot_count);
+    header->element_size = static_cast<std::uint32_t>(element_size);
+    header->slot_size = slot_size;
+    header->writer_pid = static_cast<std::int32_t>(getpid());
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = detail::magic;
+    name_ = name;
+    element_size_ = element_size;
+    max_pixels_ = max_pixels;
   }
-  static void assign(Tango::DevLong& lhs, std::int32_t rhs)
+
+  void close()
   {
-    lhs = static_cast<Tango::DevLong>(rhs);
+    if (!mapping_)
+      return;
+    mapping_ = {};
+    shm_unlink(name_.c_str());
+    name_.clear();
   }
-};
 
-template <>
-struct to_tango<std::string>
-{
-  static Tango::DevString convert(std::string const& rhs)
+  bool is_open() const { return static_cast<bool>(mapping_); }
+  std::string const& name() const { return name_; }
+
+  // Copies the frame to the next slot
+  template <class T>
+  descriptor write(T const* pixels, std::size_t width, std::size_t height)
   {
-    return Tango::string_dup(rhs.c_str());
+    if (sizeof(T) != element_size_ || width * height > max_pixels_)
+      throw std::length_error("The frame does not fit the shared memory slots of " + name_);
+
+    auto header = mapping_.header();
+    auto frame = ++frame_;
+    auto index = (frame - 1) % header->slot_count;
+    auto slot = mapping_.slot(index);
+
+    auto sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(detail::mapping::pixels(slot), pixels, width * height * sizeof(T));
+    slot->frame.store(frame, std::memory_order_relaxed);
+    slot->width.store(static_cast<std::uint32_t>(width), std::memory_order_relaxed);
+    slot->height.store(static_cast<std::uint32_t>(height), std::memory_order_relaxed);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+
+    header->latest_frame.store(frame, std::memory_order_release);
+    return {index, frame, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height)};
   }
 
-  static void assign(Tango::DevString& lhs, std::string const& rhs)
+  // The last frame written, which might be overwritten by the time a client looks at it
+  descriptor latest() const
   {
-    lhs = Tango::string_dup(rhs.c_str());
+    if (!mapping_)
+      return {};
+
+    auto header = mapping_.header();
+    auto frame = header->latest_frame.load(std::memory_order_acquire);
+    if (frame == 0)
+      return {};
+
+    auto index = (frame - 1) % header->slot_count;
+    auto slot = mapping_.slot(index);
+    return {index, frame, slot->width.load(std::memory_order_relaxed), slot->height.load(std::memory_order_relaxed)};
   }
+
+private:
+  detail::mapping mapping_;
+  std::string name_;
+  std::size_t element_size_ = 0;
+  std::size_t max_pixels_ = 0;
+  std::uint64_t frame_ = 0;
 };
 
-template <>
-struct to_tango<image<std::uint8_t>>
+// A frame in a mapped segment. The writer reuses the slot after a few frames,
+// so the pixels are only known to be consistent when valid() is still true after using them.
+template <class T>
+class frame_view
 {
-  static void assign(Tango::EncodedAttribute& lhs, image<std::uint8_t>& rhs)
+public:
+  frame_view() = default;
+  frame_view(T const* data, std::size_t width, std::size_t height, detail::slot_header const* slot, std::uint64_t sequence)
+  : data(data), width(width), height(height), slot_(slot), sequence_(sequence) {}
+
+  bool valid() const
   {
-    lhs.encode_gray8(rhs.data.data(), rhs.width, rhs.height);
+    if (slot_ == nullptr)
+      return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot_->sequence.load(std::memory_order_relaxed) == sequence_;
   }
+
+  T const* data = nullptr;
+  std::size_t width = 0;
+  std::size_t height = 0;
+
+private:
+  detail::slot_header const* slot_ = nullptr;
+  std::uint64_t sequence_ = 0;
 };
 
-template <>
-struct to_tango<image<std::uint16_t>>
+// Maps a segment read only, for clients on the same host as the device server
+class ring_reader
 {
-  static void assign(Tango::EncodedAttribute& lhs, image<std::uint16_t>& rhs)
+public:
+  explicit ring_reader(std::string const& name)
+  {
+    auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw detail::last_error("Cannot open shared memory " + name);
+
+    struct stat info{};
+    if (fstat(fd, &info) != 0)
+    {
+      auto error = detail::last_error("Cannot open shared memory " + name);
+      close(fd);
+      throw error;
+    }
+    mapping_ = detail::map(fd, static_cast<std::size_t>(info.st_size), PROT_READ, name);
+
+    auto header = mapping_.header();
+    if (static_cast<std::size_t>(info.st_size) < sizeof(detail::segment_header)
+      || header->magic != detail::magic || header->version != detail::version)
+    {
+      throw std::runtime_error(name + " is not a compatible hula segment");
+    }
+  }
+
+  // The latest frame, or an invalid view when nothing was written yet
+  template <class T>
+  frame_view<T> latest() const
+  {
+    auto header = mapping_.header();
+    auto frame = header->latest_frame.load(std::memory_order_acquire);
+    if (frame == 0)
+      return {};
+    return at<T>({(frame - 1) % header->slot_count, frame});
+  }
+
+  // The frame from a descriptor, or an invalid view when it was overwritten already
+  template <class T>
+  frame_view<T> at(descriptor const& where) const
   {
-    lhs.encode_gray16(rhs.data.data(), rhs.width, rhs.height);
+    auto header = mapping_.header();
+    if (sizeof(T) != header->element_size)
+      throw std::invalid_argument("The pixel type does not match the shared memory segment");
+    if (where.frame == 0 || where.slot >= header->slot_count)
+      return {};
+
+    auto slot = mapping_.slot(where.slot);
+    auto sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence % 2 != 0 || slot->frame.load(std::memory_order_relaxed) != where.frame)
+      return {};
+
+    return {reinterpret_cast<T const*>(detail::mapping::pixels(slot)),
+      slot->width.load(std::memory_order_relaxed), slot->height.load(std::memory_order_relaxed), slot, sequence};
   }
+
+private:
+  detail::mapping mapping_;
 };
 
-// NOTE: these instantiations do not currently overlap with the uint16 and uint8 variants,
-// because we do not have those as basic datatypes yet
-template <class T>
-struct to_tango<image<T>>
+} // shm
+} // hula
+)--";
+
+constexpr char const* HULA_IMPLEMENTATION_PUBLIC_SECTION_START = R"(
+} // namespace
+)";
+
+constexpr char const* HULA_SHARD_HEADER = R"(// Generated by hula. DO NOT MODIFY, CHANGES WILL BE LOST.
+#include "hula_internal.hpp"
+)";
+
+
+// Windows refuses to rename onto a file that another process has open, e.g. an IDE or a compiler.
+// Those usually let go quickly, otherwise copying over the file still works while it is only shared for reading.
+void replace_file(std::filesystem::path const& source, std::filesystem::path const& target)
 {
-  template <class X>
-  static void assign(image<X>& lhs, image<T> const& rhs)
+  constexpr int attempts = 5;
+  for (int attempt = 1; ; ++attempt)
   {
-    lhs = image<X>::cast(rhs);
+    try
+    {
+      std::filesystem::rename(source, target);
+      return;
+    }
+    catch (std::filesystem::filesystem_error const&)
+    {
+      if (attempt == attempts)
+        break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(50 * attempt));
+    }
   }
-};
+  std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::remove(source);
+}
 
-template <>
-struct to_tango<std::vector<std::int32_t>>
+bool write_if_changed(std::filesystem::path const& path, std::string const& content)
 {
-  static Tango::DevVarLongArray* convert(std::vector<std::int32_t> const& rhs)
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (!error && size == content.size())
   {
-    return copied_to_tango<Tango::DevVarLongArray>(rhs);
+    std::ifstream existing(path, std::ios::binary);
+    std::string current{std::istreambuf_iterator<char>(existing), std::istreambuf_iterator<char>()};
+    if (existing && current == content)
+      return false;
   }
 
-  static void assign(std::vector<Tango::DevLong>& lhs, std::vector<std::int32_t> const& rhs)
+  // Write next to the target and rename, so a build never sees a partially written file
+  auto temporary = path;
+  temporary += ".tmp";
+  try
   {
-    assign_to(lhs, rhs);
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out << content;
+      if (!out.flush())
+        throw std::runtime_error("Cannot write " + temporary.string());
+    }
+    replace_file(temporary, path);
   }
-};
+  catch (...)
+  {
+    std::filesystem::remove(temporary, error);
+    throw;
+  }
+  return true;
+}
 
-template <>
-struct to_tango<std::vector<double>>
+std::string escape_for_depfile(std::filesystem::path const& path)
 {
-  static Tango::DevVarDoubleArray* convert(std::vector<double> const& rhs)
+  std::string result;
+  for (auto c : path.generic_string())
   {
-    return copied_to_tango<Tango::DevVarDoubleArray>(rhs);
+    if (c == ' ' || c == '#' || c == '\\')
+      result += '\\';
+    else if (c == '$')
+      result += '$';
+    result += c;
   }
+  return result;
+}
 
-  static void assign(std::vector<Tango::DevDouble>& lhs, std::vector<double> const& rhs)
+std::string build_depfile(std::filesystem::path const& target, std::vector<std::filesystem::path> const& inputs)
+{
+  std::ostringstream str;
+  str << escape_for_depfile(target) << ":";
+  for (auto const& each : inputs)
   {
-    assign_to(lhs, rhs);
+    str << " \\\n  " << escape_for_depfile(each);
   }
-};
+  str << "\n";
+  return str.str();
+}
 
-template <>
-struct to_tango<std::vector<float>>
+bool uses_shared_memory(std::vector<device_server_spec> const& spec_list)
 {
-  static Tango::DevVarFloatArray* convert(std::vector<double> const& rhs)
+  return std::any_of(spec_list.begin(), spec_list.end(), [](device_server_spec const& spec)
   {
-    return copied_to_tango<Tango::DevVarFloatArray>(rhs);
-  }
+    return std::any_of(spec.attributes.begin(), spec.attributes.end(), has_shared_memory);
+  });
+}
 
-  static void assign(std::vector<Tango::DevFloat>& lhs, std::vector<float> const& rhs)
+// The shared memory header needs POSIX, so it is only included when an attribute uses it
+void write_implementation_header(std::ostream& out, std::vector<device_server_spec> const& spec_list)
+{
+  out << HULA_IMPLEMENTATION_INCLUDES;
+  if (uses_shared_memory(spec_list))
   {
-    assign_to(lhs, rhs);
+    out << "#include \"hula_shm.hpp\"\n";
   }
-};
+  out << HULA_IMPLEMENTATION_HEADER;
+}
 
-template <class T>
-struct from_tango
+// The adaptor, attribute, command and device classes of one spec, followed by their public definitions
+void build_device_implementation(std::ostream& out, std::ostream& public_section,
+  device_server_spec const& spec, serialization_t serialization)
 {
-  static void load(T& lhs, Tango::DbDatum& rhs)
+  out << build_adaptor_class(spec, serialization);
+
+  out << build_grouping_namespace_start(spec);
+  for (auto const& each : spec.attributes)
   {
-    rhs >> lhs;
+    out << attribute_class(spec.ds_name, each, serialization) << std::endl;
+    if (each.reduction)
+      out << reduction_attribute_classes(spec.ds_name, each, serialization) << std::endl;
+    if (has_shared_memory(each))
+      out << shared_memory_attribute_classes(spec.ds_name, each, serialization) << std::endl;
   }
-};
 
-template <>
-struct from_tango<std::int32_t>
-{
-  static void load(std::int32_t& lhs, Tango::DbDatum& rhs)
+  for (auto const& each : spec.commands)
   {
-    Tango::DevLong tmp{};
-    rhs >> tmp;
-    lhs = static_cast<std::int32_t>(tmp);
+    out << command_class(spec.ds_name, each) << std::endl;
   }
-};
+  out << build_grouping_namespace_end(spec);
+  out << build_device_class(spec);
 
+  public_section << build_base_class_implementation(spec, serialization);
+  public_section << build_class_functions(spec);
+}
 
-[[noreturn]] void convert_exception()
+// Distributes the specs over the shards, heaviest first onto the lightest shard
+std::vector<std::vector<device_server_spec const*>> assign_shards(std::vector<device_server_spec> const& spec_list,
+  std::size_t shard_count)
 {
-  try
+  std::vector<device_server_spec const*> by_weight;
+  for (auto const& spec : spec_list)
+    by_weight.push_back(&spec);
+
+  auto weight = [](device_server_spec const* spec) { return spec->attributes.size() + spec->commands.size() + 1; };
+  std::stable_sort(by_weight.begin(), by_weight.end(), [&](auto lhs, auto rhs) { return weight(lhs) > weight(rhs); });
+
+  std::vector<std::vector<device_server_spec const*>> shards(shard_count);
+  std::vector<std::size_t> load(shard_count, 0);
+  for (auto spec : by_weight)
   {
-    throw;
+    auto lightest = std::min_element(load.begin(), load.end()) - load.begin();
+    shards[lightest].push_back(spec);
+    load[lightest] += weight(spec);
   }
-  catch (Tango::DevFailed const&)
+  return shards;
+}
+
+std::size_t parse_shard_count(std::string const& text)
+{
+  if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; }))
   {
-    throw;
+    throw std::invalid_argument(fmt::format("Invalid shard count \"{0}\"", text));
   }
-  catch (std::exception const& e)
+  auto count = std::stoul(text);
+  if (count < 1)
   {
-    Tango::Except::throw_exception("STD_EXCEPTION", e.what(), "convert_exception()");
+    throw std::invalid_argument("The shard count has to be at least 1");
   }
-  catch (...)
+  return count;
+}
+
+// A build would otherwise keep compiling the devices of a shard that no longer exists, next to their new shard
+void remove_stale_shards(std::filesystem::path const& output_path, std::size_t shard_count)
+{
+  std::string const prefix = "hula_generated_";
+  for (auto const& entry : std::filesystem::directory_iterator(output_path))
   {
-    Tango::Except::throw_exception("UNKNOWN_EXCEPTION", "Unknown exception", "convert_exception()");
+    auto name = entry.path().filename().string();
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 || entry.path().extension() != ".cpp")
+      continue;
+
+    auto index = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+    if (!std::all_of(index.begin(), index.end(), [](char c) { return c >= '0' && c <= '9'; }))
+      continue;
+    if (std::stoul(index) >= shard_count)
+      std::filesystem::remove(entry.path());
+  }
+  if (shard_count == 0)
+  {
+    std::filesystem::remove(output_path / "hula_internal.hpp");
   }
 }
 
-inline Tango::DevState convert_state(device_state s)
+std::vector<std::filesystem::path> list_outputs(std::vector<device_server_spec> const& spec_list,
+  std::filesystem::path const& output_path, generator_options const& options)
 {
-  // Make sure the hula definitions match up
-  static_assert(static_cast<Tango::DevState>(device_state::on)==Tango::ON, "ON does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::off)==Tango::OFF, "OFF does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::close)==Tango::CLOSE, "CLOSE does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::open)==Tango::OPEN, "OPEN does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::insert)==Tango::INSERT, "INSERT does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::extract)==Tango::EXTRACT, "EXTRACT does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::moving)==Tango::MOVING, "MOVING does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::standby)==Tango::STANDBY, "STANDBY does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::fault)==Tango::FAULT, "FAULT does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::init)==Tango::INIT, "INIT does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::running)==Tango::RUNNING, "RUNNING does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::alarm)==Tango::ALARM, "ALARM does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::disable)==Tango::DISABLE, "DISABLE does not match up");
-  static_assert(static_cast<Tango::DevState>(device_state::unknown)==Tango::UNKNOWN, "UNKNOWN does not match up");
-  return static_cast<Tango::DevState>(s);
+  std::vector<std::filesystem::path> outputs{output_path / "hula_common.hpp"};
+  for (auto const& spec : spec_list)
+  {
+    outputs.push_back(output_path / spec.header_name);
+  }
+  outputs.push_back(output_path / "hula_generated.hpp");
+  if (uses_shared_memory(spec_list))
+  {
+    outputs.push_back(output_path / "hula_shm.hpp");
+  }
+  if (options.shards != 0)
+  {
+    outputs.push_back(output_path / "hula_internal.hpp");
+    for (std::size_t i = 0; i < options.shards; ++i)
+    {
+      outputs.push_back(output_path / fmt::format("hula_generated_{0}.cpp", i));
+    }
+  }
+  outputs.push_back(output_path / "hula_generated.cpp");
+  return outputs;
 }
 
-)--";
-
-constexpr char const* HULA_IMPLEMENTATION_PUBLIC_SECTION_START = R"(
-} // namespace
-)";
-
-
 void generate_code(std::vector<device_server_spec> const& spec_list,
-  std::filesystem::path const& output_path)
+  std::filesystem::path const& output_path, generator_options const& options)
 {
-  std::ofstream header_file(output_path / "hula_generated.hpp");
-  std::ofstream source_file(output_path / "hula_generated.cpp");
-  header_file << HULA_HEADER_HEADER;
-  source_file << HULA_IMPLEMENTATION_HEADER;
-
+  // The types shared by all devices, one header per device and an umbrella header with the runner.
+  // User code that includes only its own device header is not affected by changes to the others.
+  std::ostringstream common_file;
+  common_file << HULA_HEADER_HEADER;
+  common_file << HULA_HEADER_FOOTER;
+  write_if_changed(output_path / "hula_common.hpp", common_file.str());
+
+  std::ostringstream header_file;
+  header_file << HULA_UMBRELLA_HEADER;
   for (auto const& spec : spec_list)
   {
-    header_file << build_device_properties_struct(spec);
-    header_file << build_base_class(spec);
+    std::ostringstream device_header_file;
+    device_header_file << HULA_DEVICE_HEADER_HEADER;
+    device_header_file << build_device_properties_struct(spec);
+    device_header_file << build_base_class(spec);
+    device_header_file << HULA_HEADER_FOOTER;
+    write_if_changed(output_path / spec.header_name, device_header_file.str());
+    header_file << fmt::format("#include \"{0}\"\n", spec.header_name);
+  }
+  header_file << "\nnamespace hula {\n\n";
+  header_file << build_runner_declaration(spec_list);
+  header_file << HULA_HEADER_FOOTER;
+  write_if_changed(output_path / "hula_generated.hpp", header_file.str());
 
-    std::ostream& out = source_file;
+  if (uses_shared_memory(spec_list))
+  {
+    write_if_changed(output_path / "hula_shm.hpp", HULA_SHM_HEADER);
+  }
 
-    out << build_adaptor_class(spec);
+  auto serialization = serialization_model(spec_list);
+  std::ostringstream source_file;
+  if (options.shards == 0)
+  {
+    write_implementation_header(source_file, spec_list);
 
-    out << build_grouping_namespace_start(spec);
-    for (auto const& each : spec.attributes)
+    std::ostringstream public_section;
+    for (auto const& spec : spec_list)
     {
-      out << attribute_class(spec.ds_name, each) << std::endl;
+      build_device_implementation(source_file, public_section, spec, serialization);
     }
 
-    for (auto const& each : spec.commands)
+    source_file << HULA_IMPLEMENTATION_PUBLIC_SECTION_START;
+    source_file << build_class_declarations(spec_list);
+    source_file << public_section.str();
+  }
+  else
+  {
+    // The helpers go to an internal header and the devices to separate translation units that compile in parallel
+    std::ostringstream internal_file;
+    internal_file << "#pragma once\n";
+    write_implementation_header(internal_file, spec_list);
+    internal_file << HULA_IMPLEMENTATION_PUBLIC_SECTION_START;
+    internal_file << build_class_declarations(spec_list);
+    write_if_changed(output_path / "hula_internal.hpp", internal_file.str());
+
+    auto shards = assign_shards(spec_list, options.shards);
+    for (std::size_t i = 0; i < shards.size(); ++i)
     {
-      out << command_class(spec.ds_name, each) << std::endl;
+      std::ostringstream shard_file;
+      shard_file << HULA_SHARD_HEADER;
+      shard_file << "\nnamespace {\n";
+
+      std::ostringstream public_section;
+      for (auto spec : shards[i])
+      {
+        build_device_implementation(shard_file, public_section, *spec, serialization);
+      }
+
+      shard_file << HULA_IMPLEMENTATION_PUBLIC_SECTION_START;
+      shard_file << public_section.str();
+      write_if_changed(output_path / fmt::format("hula_generated_{0}.cpp", i), shard_file.str());
     }
-    out << build_grouping_namespace_end(spec);
-    out << build_device_class(spec);
-  }
 
-  header_file << build_runner_declaration(spec_list);
-  header_file << HULA_HEADER_FOOTER;
+    source_file << HULA_SHARD_HEADER;
+  }
 
-  source_file << HULA_IMPLEMENTATION_PUBLIC_SECTION_START;
   source_file << build_class_factory(spec_list);
-  source_file << build_runner(spec_list);
+  source_file << build_runner(spec_list, serialization);
+  write_if_changed(output_path / "hula_generated.cpp", source_file.str());
+  remove_stale_shards(output_path, options.shards);
 }
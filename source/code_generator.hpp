@@ -3,5 +3,25 @@
 #include <filesystem>
 #include <vector>
 
+struct generator_options
+{
+  // Number of translation units for the devices, 0 puts everything into hula_generated.cpp
+  std::size_t shards = 0;
+};
+
+// Parses the value of --shards, which has to be a plain positive number
+std::size_t parse_shard_count(std::string const& text);
+
+// Also removes the shard sources and the internal header of earlier runs that this one does not generate
 void generate_code(std::vector<device_server_spec> const& spec_list,
-  std::filesystem::path const& output_path);
+  std::filesystem::path const& output_path, generator_options const& options = {});
+
+// The files generate_code writes for these specs and options, so build systems can know them before generating
+std::vector<std::filesystem::path> list_outputs(std::vector<device_server_spec> const& spec_list,
+  std::filesystem::path const& output_path, generator_options const& options = {});
+
+// Replaces the file only when the content differs, so unchanged outputs keep their timestamps. Returns whether it wrote.
+bool write_if_changed(std::filesystem::path const& path, std::string const& content);
+
+// Makefile style dependencies of target on inputs, as understood by make, ninja and CMake's DEPFILE
+std::string build_depfile(std::filesystem::path const& target, std::vector<std::filesystem::path> const& inputs);
@@ -24,6 +24,19 @@ std::uint32_t parse_integer(std::string_view const& rhs)
   return result;
 }
 
+void check_threshold(std::string const& rhs)
+{
+  if (rhs.empty())
+    return;
+
+  std::size_t count = 0;
+  auto result = std::stod(rhs, &count);
+  if (count != rhs.size() || result < 0.)
+  {
+    throw std::invalid_argument("Malformed event threshold: " + rhs);
+  }
+}
+
 std::uint32_t parse_size(std::string_view const& rhs)
 {
   auto result = parse_integer(rhs);
@@ -89,6 +102,90 @@ display_level_t toml::from<display_level_t>::from_toml(value const& v)
   throw std::invalid_argument("Invalid attribute display level: " + v.as_string().str);
 }
 
+read_mode_t toml::from<read_mode_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "copy")
+    return read_mode_t::copy;
+  if (v.as_string() == "in_place")
+    return read_mode_t::in_place;
+  if (v.as_string() == "view")
+    return read_mode_t::view;
+  throw std::invalid_argument("Invalid attribute read mode: " + v.as_string().str);
+}
+
+encoding_t toml::from<encoding_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "raw")
+    return encoding_t::raw;
+  if (v.as_string() == "jpeg")
+    return encoding_t::jpeg;
+  throw std::invalid_argument("Invalid attribute encoding: " + v.as_string().str);
+}
+
+write_mode_t toml::from<write_mode_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "copy")
+    return write_mode_t::copy;
+  if (v.as_string() == "view")
+    return write_mode_t::view;
+  throw std::invalid_argument("Invalid attribute write mode: " + v.as_string().str);
+}
+
+return_mode_t toml::from<return_mode_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "copy")
+    return return_mode_t::copy;
+  if (v.as_string() == "in_place")
+    return return_mode_t::in_place;
+  throw std::invalid_argument("Invalid command return mode: " + v.as_string().str);
+}
+
+source_t toml::from<source_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "call")
+    return source_t::call;
+  if (v.as_string() == "snapshot")
+    return source_t::snapshot;
+  throw std::invalid_argument("Invalid attribute source: " + v.as_string().str);
+}
+
+serialization_t toml::from<serialization_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "by_device")
+    return serialization_t::by_device;
+  if (v.as_string() == "by_class")
+    return serialization_t::by_class;
+  if (v.as_string() == "by_process")
+    return serialization_t::by_process;
+  if (v.as_string() == "none")
+    return serialization_t::none;
+  throw std::invalid_argument("Invalid serialization model: " + v.as_string().str);
+}
+
+lazy_init_state_t toml::from<lazy_init_state_t>::from_toml(value const& v)
+{
+  if (v.as_string() == "init")
+    return lazy_init_state_t::init;
+  if (v.as_string() == "unknown")
+    return lazy_init_state_t::unknown;
+  throw std::invalid_argument("Invalid lazy init state: " + v.as_string().str);
+}
+
+event_kinds_t toml::from<event_kinds_t>::from_toml(value const& v)
+{
+  event_kinds_t result;
+  for (auto const& each : v.as_array())
+  {
+    if (each.as_string() == "change")
+      result.change = true;
+    else if (each.as_string() == "archive")
+      result.archive = true;
+    else
+      throw std::invalid_argument("Invalid event kind: " + each.as_string().str);
+  }
+  return result;
+}
+
 attribute_type_t::attribute_type_t(toml::value const& rhs)
 // Need an explicit type here to convert from toml::string to std::string
 : attribute_type_t(static_cast<std::string const&>(rhs.as_string()))
@@ -149,4 +246,179 @@ command_type_t::command_type_t(std::string const& type_code)
   {
     throw std::invalid_argument("Cannot have void arrays");
   }
+
+  // Tango has no single byte command argument, only byte arrays
+  if (!is_array && type == value_type::uint8_t)
+  {
+    throw std::invalid_argument("Commands cannot take or return uint8, use uint8[] instead");
+  }
+}
+
+attribute::attribute(toml::value const& v)
+: name(toml::find<std::string>(v, "name"))
+, type(toml::find<attribute_type_t>(v, "type"))
+, access(toml::find_or<access_type>(v, "access", access_type::read_only))
+, description(toml::find_or<std::string>(v, "description", ""))
+, min_value(toml::find_or<std::string>(v, "min_value", ""))
+, max_value(toml::find_or<std::string>(v, "max_value", ""))
+, min_alarm(toml::find_or<std::string>(v, "min_alarm", ""))
+, max_alarm(toml::find_or<std::string>(v, "max_alarm", ""))
+, unit(toml::find_or<std::string>(v, "unit", ""))
+, display_level(toml::find_or<display_level_t>(v, "display_level", display_level_t::operator_level))
+, read_mode(toml::find_or<read_mode_t>(v, "read_mode", read_mode_t::copy))
+, write_mode(toml::find_or<write_mode_t>(v, "write_mode", write_mode_t::copy))
+, source(toml::find_or<source_t>(v, "source", source_t::call))
+, polling_period_ms(toml::find_or<std::uint32_t>(v, "polling_period_ms", 0))
+, refresh_ms(toml::find_or<std::uint32_t>(v, "refresh_ms", 0))
+, events(toml::find_or<event_kinds_t>(v, "events", {}))
+, abs_change(toml::find_or<std::string>(v, "abs_change", ""))
+, rel_change(toml::find_or<std::string>(v, "rel_change", ""))
+, encoding(toml::find_or<encoding_t>(v, "encoding", encoding_t::raw))
+, jpeg_quality(toml::find_or<std::uint32_t>(v, "jpeg_quality", 90))
+, reduction(toml::find_or<bool>(v, "reduction", false))
+, shared_memory(toml::find_or<bool>(v, "shared_memory", false))
+, data_ready(toml::find_or<bool>(v, "data_ready", false))
+{
+  // Both modes share their memory with tango, so they need arrays of plain numbers
+  auto is_numeric_array = type.rank != attribute_rank_t::scalar && is_numeric(type.type);
+  if (read_mode == read_mode_t::in_place && !is_numeric_array)
+  {
+    throw std::invalid_argument("In place reads are only supported for numeric spectrum and image attributes");
+  }
+  if (read_mode == read_mode_t::view && !(is_numeric_array && type.rank == attribute_rank_t::image))
+  {
+    throw std::invalid_argument("View reads are only supported for numeric image attributes");
+  }
+  if (write_mode == write_mode_t::view && !is_numeric_array)
+  {
+    throw std::invalid_argument("View writes are only supported for numeric spectrum and image attributes");
+  }
+  if (write_mode != write_mode_t::copy && !is_writable(access))
+  {
+    throw std::invalid_argument("A write mode needs a writable attribute");
+  }
+  if (polling_period_ms > 0 && !is_readable(access))
+  {
+    throw std::invalid_argument("Only readable attributes can be polled");
+  }
+  if (has_alarms(*this) && !is_numeric(type.type))
+  {
+    throw std::invalid_argument("Alarm limits are only supported for numeric attributes");
+  }
+  if (source == source_t::snapshot && is_refreshed(*this))
+  {
+    throw std::invalid_argument("Snapshot attributes are published, they cannot be refreshed");
+  }
+  if (has_snapshot(*this))
+  {
+    if (!is_readable(access))
+    {
+      throw std::invalid_argument("Snapshot and refreshed attributes need to be readable");
+    }
+    if (read_mode != read_mode_t::copy)
+    {
+      throw std::invalid_argument("Snapshot and refreshed attributes need copy reads");
+    }
+  }
+
+  if (has_events(*this))
+  {
+    if (!is_readable(access))
+    {
+      throw std::invalid_argument("Events need a readable attribute");
+    }
+    if (!is_numeric(type.type) && type.type != value_type::bool_t)
+    {
+      throw std::invalid_argument("Events are only supported for numeric and bool attributes");
+    }
+  }
+  if (!abs_change.empty() || !rel_change.empty())
+  {
+    if (!has_events(*this) || !is_numeric(type.type))
+    {
+      throw std::invalid_argument("Event thresholds need numeric attributes with events");
+    }
+    check_threshold(abs_change);
+    check_threshold(rel_change);
+  }
+
+  if (v.contains("encoding") && !is_encoded(type.type))
+  {
+    throw std::invalid_argument("Only image/8, image/16 and image/rgb24 attributes have an encoding");
+  }
+  if (encoding == encoding_t::jpeg && type.type == value_type::image16_t)
+  {
+    // Tango has no 16 bit jpeg encoder
+    throw std::invalid_argument("Jpeg encoding is only supported for image/8 and image/rgb24 attributes");
+  }
+  if (v.contains("jpeg_quality"))
+  {
+    if (encoding != encoding_t::jpeg)
+    {
+      throw std::invalid_argument("A jpeg_quality needs encoding = \"jpeg\"");
+    }
+    if (jpeg_quality < 1 || jpeg_quality > 100)
+    {
+      throw std::invalid_argument("The jpeg_quality needs to be between 1 and 100");
+    }
+  }
+
+  if (reduction)
+  {
+    if (!is_numeric_array || !is_readable(access))
+    {
+      throw std::invalid_argument("Reduction is only supported for readable numeric spectrum and image attributes");
+    }
+    if (read_mode != read_mode_t::copy)
+    {
+      throw std::invalid_argument("Reduced attributes need copy reads");
+    }
+  }
+
+  if (data_ready && !is_readable(access))
+  {
+    throw std::invalid_argument("Data ready events need a readable attribute");
+  }
+
+  // The frames are written to shared memory when they are published
+  if (shared_memory && (type.rank != attribute_rank_t::image || !is_numeric(type.type) || source != source_t::snapshot))
+  {
+    throw std::invalid_argument("Shared memory is only supported for numeric image attributes with source = \"snapshot\"");
+  }
+}
+
+command::command(toml::value const& v)
+: name(toml::find<std::string>(v, "name"))
+, return_type(toml::find<command_type_t>(v, "return_type"))
+, return_description(toml::find_or<std::string>(v, "return_description", ""))
+, return_mode(toml::find_or<return_mode_t>(v, "return_mode", return_mode_t::copy))
+, parameter_type(toml::find<command_type_t>(v, "parameter_type"))
+, parameter_description(toml::find_or<std::string>(v, "parameter_description", ""))
+, display_level(toml::find_or<display_level_t>(v, "display_level", display_level_t::operator_level))
+, polling_period_ms(toml::find_or<std::uint32_t>(v, "polling_period_ms", 0))
+{
+  if (polling_period_ms > 0 && parameter_type.type != value_type::void_t)
+  {
+    throw std::invalid_argument("Only commands without parameters can be polled");
+  }
+  if (return_mode == return_mode_t::in_place && (!return_type.is_array || !is_numeric(return_type.type)))
+  {
+    throw std::invalid_argument("In place returns are only supported for numeric array commands");
+  }
+}
+
+serialization_t serialization_model(std::vector<device_server_spec> const& spec_list)
+{
+  std::optional<serialization_t> result;
+  for (auto const& spec : spec_list)
+  {
+    if (!spec.serialization)
+      continue;
+    if (result && *result != *spec.serialization)
+    {
+      throw std::invalid_argument("Conflicting serialization models in " + spec.name.snake_cased());
+    }
+    result = spec.serialization;
+  }
+  return result.value_or(serialization_t::by_device);
 }
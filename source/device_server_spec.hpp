@@ -3,6 +3,8 @@
 #include <fmt/format.h>
 #include "uncased_name.hpp"
 #include "types.hpp"
+#include <optional>
+#include <algorithm>
 
 enum class access_type
 {
@@ -17,6 +19,68 @@ enum class display_level_t
   expert_level,
 };
 
+enum class read_mode_t
+{
+  // read_x() returns a fresh value that is converted to the tango representation
+  copy,
+  // read_x(value) fills a buffer that hula keeps per attribute and hands to tango directly
+  in_place,
+  // read_x() returns a possibly strided image_view, contiguous views are handed to tango without a copy
+  view,
+};
+
+enum class write_mode_t
+{
+  // write_x(...) receives a copy of the written value
+  copy,
+  // write_x(...) receives a non-owning view of tango's write buffer
+  view,
+};
+
+enum class return_mode_t
+{
+  // the command returns a value that is copied to a new tango sequence
+  copy,
+  // the command writes its result to a tango sequence that hula hands out
+  in_place,
+};
+
+enum class source_t
+{
+  // the generated read calls read_x() on the implementation
+  call,
+  // the implementation publishes values from its own threads, the generated read takes the latest one
+  snapshot,
+};
+
+enum class encoding_t
+{
+  // uncompressed pixels
+  raw,
+  // lossy jpeg with the attribute's jpeg_quality
+  jpeg,
+};
+
+enum class serialization_t
+{
+  by_device,
+  by_class,
+  by_process,
+  none,
+};
+
+enum class lazy_init_state_t
+{
+  init,
+  unknown,
+};
+
+struct event_kinds_t
+{
+  bool change = false;
+  bool archive = false;
+};
+
 inline bool is_readable(access_type rhs)
 {
   switch (rhs)
@@ -51,6 +115,14 @@ namespace toml
     return toml::find<T>(v, key);
   }
 
+  template <typename T>
+  auto find_optional(toml::value const& v, std::string const& key) -> std::optional<T>
+  {
+    if (!v.contains(key)) return std::nullopt;
+
+    return toml::find<T>(v, key);
+  }
+
   template<>
   struct from<value_type>
   {
@@ -72,6 +144,54 @@ namespace toml
   {
     static display_level_t from_toml(value const& v);
   };
+
+  template<>
+  struct from<read_mode_t>
+  {
+    static read_mode_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<write_mode_t>
+  {
+    static write_mode_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<return_mode_t>
+  {
+    static return_mode_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<source_t>
+  {
+    static source_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<encoding_t>
+  {
+    static encoding_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<serialization_t>
+  {
+    static serialization_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<lazy_init_state_t>
+  {
+    static lazy_init_state_t from_toml(value const& v);
+  };
+
+  template<>
+  struct from<event_kinds_t>
+  {
+    static event_kinds_t from_toml(value const& v);
+  };
 }
 
 struct device_property
@@ -113,17 +233,7 @@ struct command_type_t
 struct attribute
 {
   attribute() = default;
-  explicit attribute(toml::value const& v)
-  : name(toml::find<std::string>(v, "name"))
-  , type(toml::find<attribute_type_t>(v, "type"))
-  , access(toml::find_or<access_type>(v, "access", access_type::read_only))
-  , description(toml::find_or<std::string>(v, "description", ""))
-  , min_value(toml::find_or<std::string>(v, "min_value", ""))
-  , max_value(toml::find_or<std::string>(v, "max_value", ""))
-  , unit(toml::find_or<std::string>(v, "unit", ""))
-  , display_level(toml::find_or<display_level_t>(v, "display_level", display_level_t::operator_level))
-  {
-  }
+  explicit attribute(toml::value const& v);
 
   uncased_name name;
   attribute_type_t type;
@@ -131,32 +241,82 @@ struct attribute
   std::string description;
   std::string min_value;
   std::string max_value;
+  std::string min_alarm;
+  std::string max_alarm;
   std::string unit;
   display_level_t display_level = display_level_t::operator_level;
+  read_mode_t read_mode = read_mode_t::copy;
+  write_mode_t write_mode = write_mode_t::copy;
+  source_t source = source_t::call;
+  // Polling period for tango's polling thread, 0 leaves the attribute unpolled
+  std::uint32_t polling_period_ms = 0;
+  // Period for reading the attribute in the background, 0 reads it on client requests.
+  // The background reads do not take tango's device monitor, so they run concurrently with everything else.
+  std::uint32_t refresh_ms = 0;
+  event_kinds_t events;
+  std::string abs_change;
+  std::string rel_change;
+  // How image/8 and image/rgb24 attributes are encoded for the client
+  encoding_t encoding = encoding_t::raw;
+  std::uint32_t jpeg_quality = 90;
+  // Clients pick a region of interest and a binning (images) or decimation (spectrums) through companion attributes
+  bool reduction = false;
+  // Published frames also go to a shared memory ring that clients on the same host can map
+  bool shared_memory = false;
+  // The implementation announces new values with data ready events, so clients do not need to poll
+  bool data_ready = false;
 };
 
+inline bool has_events(attribute const& rhs)
+{
+  return rhs.events.change || rhs.events.archive;
+}
+
+inline bool has_alarms(attribute const& rhs)
+{
+  return !rhs.min_alarm.empty() || !rhs.max_alarm.empty();
+}
+
+inline bool is_refreshed(attribute const& rhs)
+{
+  return rhs.refresh_ms > 0;
+}
+
+inline bool has_shared_memory(attribute const& rhs)
+{
+  return rhs.shared_memory;
+}
+
+// Published and refreshed attributes are both read from a snapshot
+inline bool has_snapshot(attribute const& rhs)
+{
+  return rhs.source == source_t::snapshot || is_refreshed(rhs);
+}
+
+// Copy and in-place reads call the implementation for each client request, the others hand out snapshots or views
+inline bool is_read_on_request(attribute const& rhs)
+{
+  return is_readable(rhs.access) && !has_snapshot(rhs)
+    && (rhs.read_mode == read_mode_t::copy || rhs.read_mode == read_mode_t::in_place);
+}
+
 struct command
 {
   command() = default;
-  explicit command(toml::value const& v)
-  : name(toml::find<std::string>(v, "name"))
-  , return_type(toml::find<command_type_t>(v, "return_type"))
-  , return_description(toml::find_or<std::string>(v, "return_description", ""))
-  , parameter_type(toml::find<command_type_t>(v, "parameter_type"))
-  , parameter_description(toml::find_or<std::string>(v, "parameter_description", ""))
-  , display_level(toml::find_or<display_level_t>(v, "display_level", display_level_t::operator_level))
-  {
-  }
+  explicit command(toml::value const& v);
 
   uncased_name name;
 
   command_type_t return_type;
   std::string return_description;
+  return_mode_t return_mode = return_mode_t::copy;
 
   command_type_t parameter_type;
   std::string parameter_description;
 
   display_level_t display_level = display_level_t::operator_level;
+  // Polling period for tango's polling thread, 0 leaves the command unpolled
+  std::uint32_t polling_period_ms = 0;
 };
 
 struct raw_device_server_spec
@@ -166,13 +326,62 @@ struct raw_device_server_spec
   , device_properties(toml::find_or<std::vector<device_property>>(v, "device_properties"))
   , attributes(toml::find_or<std::vector<attribute>>(v, "attributes"))
   , commands(toml::find_or<std::vector<command>>(v, "commands"))
+  , batched_reads(toml::find_or<bool>(v, "batched_reads", false))
+  , serialization(toml::find_optional<serialization_t>(v, "serialization"))
+  , state_cache_ms(toml::find_or<std::uint32_t>(v, "state_cache_ms", 0))
+  , alarm_scan(toml::find_or<bool>(v, "alarm_scan", true))
+  , poll_ring_depth(toml::find_or<std::uint32_t>(v, "poll_ring_depth", 0))
+  , parallel_init(toml::find_or<std::uint32_t>(v, "parallel_init", 0))
+  , lazy_init(toml::find_or<bool>(v, "lazy_init", false))
+  , lazy_init_state(toml::find_optional<lazy_init_state_t>(v, "lazy_init_state"))
+  , group_factory(toml::find_or<bool>(v, "group_factory", false))
   {
+    if (lazy_init && parallel_init > 0)
+    {
+      throw std::invalid_argument("Lazy and parallel initialization cannot be combined");
+    }
+    if (lazy_init_state && !lazy_init)
+    {
+      throw std::invalid_argument("A lazy_init_state needs lazy_init");
+    }
+    if (group_factory && (lazy_init || parallel_init > 0))
+    {
+      throw std::invalid_argument("A group factory cannot be combined with lazy or parallel initialization");
+    }
+    if (batched_reads && std::none_of(attributes.begin(), attributes.end(), is_read_on_request))
+    {
+      throw std::invalid_argument("Batched reads need an attribute that is read on request");
+    }
+    if (!alarm_scan && std::any_of(attributes.begin(), attributes.end(), has_alarms))
+    {
+      throw std::invalid_argument("Alarm limits need the alarm scan");
+    }
   }
 
   uncased_name name;
   std::vector<device_property> device_properties;
   std::vector<attribute> attributes;
   std::vector<command> commands;
+  // Call read_attributes once per client request before the attributes are read
+  bool batched_reads = false;
+  // Tango's serialization model. Applies to the whole process, so all specs that set it have to agree
+  std::optional<serialization_t> serialization;
+  // How long one operating_state() result serves State and Status, 0 asks for every call
+  std::uint32_t state_cache_ms = 0;
+  // Check the alarm and warning limits and RDS settings of all attributes on each State and Status.
+  // This includes limits configured in the database, so only turn it off when nobody relies on those.
+  bool alarm_scan = true;
+  // Depth of the polling buffers of each device, 0 keeps tango's default
+  std::uint32_t poll_ring_depth = 0;
+  // Number of threads that run the factory for the devices of this class, 0 runs it in each constructor.
+  // The factory needs to be thread safe then.
+  std::uint32_t parallel_init = 0;
+  // Create the implementation on the first attribute, command or state access instead of on startup
+  bool lazy_init = false;
+  // State reported by lazy devices until they are accessed. Without it, querying the state initializes the device.
+  std::optional<lazy_init_state_t> lazy_init_state;
+  // Create the implementations of all devices of the class with a single factory call, e.g. to share connections
+  bool group_factory = false;
 };
 
 struct device_server_spec : raw_device_server_spec
@@ -201,6 +410,9 @@ struct device_server_spec : raw_device_server_spec
   std::string grouping_namespace_name;
 };
 
+// The serialization model for a process serving all the given specs. Defaults to tango's by_device
+serialization_t serialization_model(std::vector<device_server_spec> const& spec_list);
+
 // Facades for the type lookup
 inline char const* tango_type(command_type_t const& type)
 {
@@ -241,6 +453,15 @@ inline std::string cpp_type(attribute_type_t const& type)
   return cpp_type(type.type, type.rank != attribute_rank_t::scalar);
 }
 
+inline std::string cpp_view_parameter_list(attribute_type_t const& type)
+{
+  if (type.rank == attribute_rank_t::image)
+  {
+    return fmt::format("image_view<{0} const> rhs", cpp_type(type.type, false));
+  }
+  return fmt::format("span<{0} const> rhs", cpp_type(type.type, false));
+}
+
 inline std::string cpp_parameter_list(attribute_type_t const& type)
 {
   if (type.rank == attribute_rank_t::image)
@@ -9,12 +9,19 @@ constexpr name_type_info_t name_table[] = {
   // enum, toml-type
   {value_type::void_t,"void"},
   {value_type::bool_t, "bool"},
+  {value_type::uint8_t, "uint8"},
+  {value_type::int16_t, "int16"},
+  {value_type::uint16_t, "uint16"},
   {value_type::int32_t,"int32"},
+  {value_type::uint32_t, "uint32"},
+  {value_type::int64_t, "int64"},
+  {value_type::uint64_t, "uint64"},
   {value_type::float_t, "float" },
   {value_type::double_t, "double" },
   {value_type::string_t, "string" },
   {value_type::image8_t, "image/8" },
-  {value_type::image16_t, "image/16" }
+  {value_type::image16_t, "image/16" },
+  {value_type::rgb24_t, "image/rgb24" }
 };
 
 // See https://tango-controls.readthedocs.io/en/latest/development/device-api/device-server-writing.html?exchanging-data-between-client-and-server#exchanging-data-between-client-and-server
@@ -23,20 +30,33 @@ constexpr scalar_type_info_t scalar_table[] = {
   // enum, tango-enum, tango-type, cpp-return-type, cpp-parameter-list, toml-type
   {value_type::void_t, "Tango::DEV_VOID", nullptr, "void", ""},
   {value_type::bool_t, "Tango::DEV_BOOLEAN", "Tango::DevBoolean", "bool", "bool rhs"},
+  {value_type::uint8_t, "Tango::DEV_UCHAR", "Tango::DevUChar", "std::uint8_t", "std::uint8_t rhs"},
+  {value_type::int16_t, "Tango::DEV_SHORT", "Tango::DevShort", "std::int16_t", "std::int16_t rhs"},
+  {value_type::uint16_t, "Tango::DEV_USHORT", "Tango::DevUShort", "std::uint16_t", "std::uint16_t rhs"},
   {value_type::int32_t, "Tango::DEV_LONG", "Tango::DevLong", "std::int32_t", "std::int32_t rhs"},
+  {value_type::uint32_t, "Tango::DEV_ULONG", "Tango::DevULong", "std::uint32_t", "std::uint32_t rhs"},
+  {value_type::int64_t, "Tango::DEV_LONG64", "Tango::DevLong64", "std::int64_t", "std::int64_t rhs"},
+  {value_type::uint64_t, "Tango::DEV_ULONG64", "Tango::DevULong64", "std::uint64_t", "std::uint64_t rhs"},
   {value_type::float_t, "Tango::DEV_FLOAT", "Tango::DevFloat", "float", "float rhs" },
   {value_type::double_t, "Tango::DEV_DOUBLE", "Tango::DevDouble", "double", "double rhs" },
   // TODO: would be nice to use std::string_view instead here, but tango 9.3.3 does not support C++17 on windows yet (due to usage of std::binary_function etc..)
   {value_type::string_t, "Tango::DEV_STRING", "Tango::DevString", "std::string", "std::string const& rhs" },
   {value_type::image8_t, "Tango::DEV_ENCODED", "Tango::EncodedAttribute", "image<std::uint8_t>", "image<std::uint8_t> const& rhs" },
-  {value_type::image16_t, "Tango::DEV_ENCODED", "Tango::EncodedAttribute", "image<std::uint16_t>", "image<std::uint16_t> const& rhs" }
+  {value_type::image16_t, "Tango::DEV_ENCODED", "Tango::EncodedAttribute", "image<std::uint16_t>", "image<std::uint16_t> const& rhs" },
+  {value_type::rgb24_t, "Tango::DEV_ENCODED", "Tango::EncodedAttribute", "image<rgb24>", "image<rgb24> const& rhs" }
 };
 
 
 constexpr array_type_info_t array_table[] = {
   // enum, tango-enum, tango-type, cpp-return-type, cpp-parameter-list, toml-type
   {value_type::bool_t, "Tango::DEVVAR_BOOLEANARRAY", "Tango::DevVarBooleanArray", "std::vector<bool>", "std::vector<bool> const& rhs"},
+  {value_type::uint8_t, "Tango::DEVVAR_CHARARRAY", "Tango::DevVarCharArray", "std::vector<std::uint8_t>", "std::vector<std::uint8_t> const& rhs"},
+  {value_type::int16_t, "Tango::DEVVAR_SHORTARRAY", "Tango::DevVarShortArray", "std::vector<std::int16_t>", "std::vector<std::int16_t> const& rhs"},
+  {value_type::uint16_t, "Tango::DEVVAR_USHORTARRAY", "Tango::DevVarUShortArray", "std::vector<std::uint16_t>", "std::vector<std::uint16_t> const& rhs"},
   {value_type::int32_t, "Tango::DEVVAR_LONGARRAY", "Tango::DevVarLongArray", "std::vector<std::int32_t>", "std::vector<std::int32_t> const& rhs"},
+  {value_type::uint32_t, "Tango::DEVVAR_ULONGARRAY", "Tango::DevVarULongArray", "std::vector<std::uint32_t>", "std::vector<std::uint32_t> const& rhs"},
+  {value_type::int64_t, "Tango::DEVVAR_LONG64ARRAY", "Tango::DevVarLong64Array", "std::vector<std::int64_t>", "std::vector<std::int64_t> const& rhs"},
+  {value_type::uint64_t, "Tango::DEVVAR_ULONG64ARRAY", "Tango::DevVarULong64Array", "std::vector<std::uint64_t>", "std::vector<std::uint64_t> const& rhs"},
   {value_type::float_t, "Tango::DEVVAR_FLOATARRAY", "Tango::DevVarFloatArray", "std::vector<float>", "std::vector<float> const& rhs" },
   {value_type::double_t, "Tango::DEVVAR_DOUBLEARRAY", "Tango::DevVarDoubleArray", "std::vector<double>", "std::vector<double> const& rhs" },
   {value_type::string_t, "Tango::DEVVAR_STRINGARRAY", "Tango::DevVarStringArray", "std::vector<std::string>", "std::vector<std::string> const& rhs" },
@@ -131,6 +151,38 @@ std::string_view name_for(value_type v)
   return name_map.at(v);
 }
 
+bool is_numeric(value_type v)
+{
+  switch (v)
+  {
+  case value_type::uint8_t:
+  case value_type::int16_t:
+  case value_type::uint16_t:
+  case value_type::int32_t:
+  case value_type::uint32_t:
+  case value_type::int64_t:
+  case value_type::uint64_t:
+  case value_type::float_t:
+  case value_type::double_t:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool is_encoded(value_type v)
+{
+  switch (v)
+  {
+  case value_type::image8_t:
+  case value_type::image16_t:
+  case value_type::rgb24_t:
+    return true;
+  default:
+    return false;
+  }
+}
+
 const char* tango_type(value_type v, bool is_array)
 {
   auto result = is_array ? array_info_for(v).tango_type : scalar_info_for(v).tango_type;
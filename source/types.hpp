@@ -6,12 +6,19 @@ enum class value_type
 {
   void_t,
   bool_t,
+  uint8_t,
+  int16_t,
+  uint16_t,
   int32_t,
+  uint32_t,
+  int64_t,
+  uint64_t,
   float_t,
   double_t,
   string_t,
   image8_t,
   image16_t,
+  rgb24_t,
 };
 
 enum class attribute_rank_t
@@ -56,5 +63,11 @@ const char* cpp_parameter_list(value_type v, bool is_array);
 
 std::string_view name_for(value_type v);
 
+// Whether values of this type are plain numbers that can be handed to tango without conversion
+bool is_numeric(value_type v);
+
+// Whether tango transfers values of this type as DEV_ENCODED
+bool is_encoded(value_type v);
+
 // reverse lookup
 value_type from_input_type(std::string_view const& v);
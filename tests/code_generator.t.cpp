@@ -0,0 +1,119 @@
+#include <catch2/catch_test_macros.hpp>
+#include "code_generator.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace toml::literals::toml_literals;
+
+namespace
+{
+std::string read_file(std::filesystem::path const& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+}
+
+TEST_CASE("write_if_changed_only_writes_different_content", "[code_generator]")
+{
+  auto directory = std::filesystem::temp_directory_path() / "hula_write_if_changed";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  auto path = directory / "hula_generated.hpp";
+
+  REQUIRE(write_if_changed(path, "first"));
+  REQUIRE(read_file(path) == "first");
+
+  REQUIRE_FALSE(write_if_changed(path, "first"));
+
+  REQUIRE(write_if_changed(path, "second"));
+  REQUIRE(read_file(path) == "second");
+  REQUIRE_FALSE(std::filesystem::exists(directory / "hula_generated.hpp.tmp"));
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("write_if_changed_removes_the_temporary_file_when_replacing_fails", "[code_generator]")
+{
+  auto directory = std::filesystem::temp_directory_path() / "hula_write_if_changed_fails";
+  std::filesystem::remove_all(directory);
+  // A directory in the way can be neither renamed nor copied over
+  std::filesystem::create_directories(directory / "hula_generated.hpp" / "occupied");
+
+  REQUIRE_THROWS_AS(write_if_changed(directory / "hula_generated.hpp", "content"), std::filesystem::filesystem_error);
+  REQUIRE_FALSE(std::filesystem::exists(directory / "hula_generated.hpp.tmp"));
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("build_depfile_lists_the_inputs_of_the_target", "[code_generator]")
+{
+  auto result = build_depfile("/out/hula_generated.hpp", {"/specs/camera.toml", "/my specs/stand.toml"});
+  REQUIRE(result == "/out/hula_generated.hpp: \\\n  /specs/camera.toml \\\n  /my\\ specs/stand.toml\n");
+}
+
+TEST_CASE("parse_shard_count_rejects_everything_but_positive_numbers", "[code_generator]")
+{
+  REQUIRE(parse_shard_count("1") == 1);
+  REQUIRE(parse_shard_count("12") == 12);
+  REQUIRE_THROWS_AS(parse_shard_count("0"), std::invalid_argument);
+  REQUIRE_THROWS_AS(parse_shard_count("-1"), std::invalid_argument);
+  REQUIRE_THROWS_AS(parse_shard_count("+4"), std::invalid_argument);
+  REQUIRE_THROWS_AS(parse_shard_count("4x"), std::invalid_argument);
+  REQUIRE_THROWS_AS(parse_shard_count(""), std::invalid_argument);
+}
+
+TEST_CASE("generate_code_removes_stale_shards", "[code_generator]")
+{
+  auto directory = std::filesystem::temp_directory_path() / "hula_stale_shards";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  generate_code({}, directory, {3});
+  REQUIRE(std::filesystem::exists(directory / "hula_generated_2.cpp"));
+  REQUIRE(std::filesystem::exists(directory / "hula_internal.hpp"));
+
+  generate_code({}, directory, {2});
+  REQUIRE(std::filesystem::exists(directory / "hula_generated_1.cpp"));
+  REQUIRE_FALSE(std::filesystem::exists(directory / "hula_generated_2.cpp"));
+
+  generate_code({}, directory, {0});
+  REQUIRE_FALSE(std::filesystem::exists(directory / "hula_generated_0.cpp"));
+  REQUIRE_FALSE(std::filesystem::exists(directory / "hula_internal.hpp"));
+  REQUIRE(std::filesystem::exists(directory / "hula_generated.cpp"));
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("list_outputs_names_every_generated_file", "[code_generator]")
+{
+  auto directory = std::filesystem::temp_directory_path() / "hula_list_outputs";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  const toml::value v = u8R"(
+    name = "CoolCamera"
+    [[attributes]]
+    name = "frame"
+    type = "uint16[64,32]"
+    source = "snapshot"
+    shared_memory = true
+)"_toml;
+  std::vector<device_server_spec> spec_list{device_server_spec{v}};
+
+  for (std::size_t shards : {0, 2})
+  {
+    generate_code(spec_list, directory, {shards});
+
+    std::vector<std::filesystem::path> written;
+    for (auto const& entry : std::filesystem::directory_iterator(directory))
+      written.push_back(entry.path());
+    auto listed = list_outputs(spec_list, directory, {shards});
+    std::sort(written.begin(), written.end());
+    std::sort(listed.begin(), listed.end());
+    REQUIRE(listed == written);
+  }
+
+  std::filesystem::remove_all(directory);
+}
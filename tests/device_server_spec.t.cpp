@@ -28,6 +28,26 @@ TEST_CASE("can_parse_matrix_attribute_type", "[attribute_type_t]")
   REQUIRE(parsed.max_size == std::array<std::uint32_t, 2>{800, 600});
 }
 
+TEST_CASE("can_parse_narrow_integer_image_type", "[attribute_type_t]")
+{
+  attribute_type_t parsed("uint16[2048, 2048]"s);
+  REQUIRE(parsed.type == value_type::uint16_t);
+  REQUIRE(parsed.rank == attribute_rank_t::image);
+}
+
+TEST_CASE("can_parse_wide_integer_command_type", "[command_type_t]")
+{
+  command_type_t parsed{"int64[]"s};
+  REQUIRE(parsed.type == value_type::int64_t);
+  REQUIRE(parsed.is_array == true);
+}
+
+TEST_CASE("command_type_throws_on_byte_scalars", "[command_type_t]")
+{
+  REQUIRE_THROWS_AS(command_type_t{"uint8"s}, std::invalid_argument);
+  REQUIRE_NOTHROW(command_type_t{"uint8[]"s});
+}
+
 TEST_CASE("throws_with_empty_type_tag", "[attribute_type_t]")
 {
   REQUIRE_THROWS_AS(attribute_type_t{"[800,600]"s}, std::invalid_argument);
@@ -83,3 +103,298 @@ TEST_CASE("attribute_type_throws_on_void_arrays", "[attribute_type_t]")
   REQUIRE_THROWS_AS(attribute_type_t{"void[2]"s}, std::invalid_argument);
   REQUIRE_THROWS_AS(attribute_type_t{"void[3,5]"s}, std::invalid_argument);
 }
+
+TEST_CASE("can_parse_in_place_read_mode", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "raw_image"
+    type = "int32[2048,2048]"
+    read_mode = "in_place"
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.read_mode == read_mode_t::in_place);
+}
+
+TEST_CASE("in_place_read_mode_throws_on_scalars_and_strings", "[attribute]")
+{
+  const toml::value scalar = u8R"(
+    name = "binning"
+    type = "int32"
+    read_mode = "in_place"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{scalar}, std::invalid_argument);
+
+  const toml::value strings = u8R"(
+    name = "notes"
+    type = "string[8]"
+    read_mode = "in_place"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{strings}, std::invalid_argument);
+}
+
+TEST_CASE("view_write_mode_throws_on_scalars", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "binning"
+    type = "int32"
+    access = ["read", "write"]
+    write_mode = "view"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{v}, std::invalid_argument);
+}
+
+TEST_CASE("in_place_return_mode_throws_on_non_array_commands", "[command]")
+{
+  const toml::value v = u8R"(
+    name = "square"
+    return_type = "int32"
+    return_mode = "in_place"
+    parameter_type = "int32"
+)"_toml;
+  REQUIRE_THROWS_AS(command{v}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_events_with_thresholds", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "temperature"
+    type = "double"
+    events = ["change", "archive"]
+    abs_change = "0.5"
+    rel_change = "2"
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.events.change);
+  REQUIRE(parsed.events.archive);
+  REQUIRE(parsed.abs_change == "0.5");
+  REQUIRE(parsed.rel_change == "2");
+}
+
+TEST_CASE("events_throw_on_strings_and_bad_thresholds", "[attribute]")
+{
+  const toml::value strings = u8R"(
+    name = "notes"
+    type = "string"
+    events = ["change"]
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{strings}, std::invalid_argument);
+
+  const toml::value without_events = u8R"(
+    name = "temperature"
+    type = "double"
+    abs_change = "0.5"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{without_events}, std::invalid_argument);
+
+  const toml::value malformed = u8R"(
+    name = "temperature"
+    type = "double"
+    events = ["change"]
+    abs_change = "0.5K"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{malformed}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_snapshot_source", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "histogram"
+    type = "int32[256]"
+    source = "snapshot"
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.source == source_t::snapshot);
+  REQUIRE(has_snapshot(parsed));
+}
+
+TEST_CASE("snapshot_source_throws_on_write_only_and_in_place", "[attribute]")
+{
+  const toml::value write_only = u8R"(
+    name = "histogram"
+    type = "int32[256]"
+    access = ["write"]
+    source = "snapshot"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{write_only}, std::invalid_argument);
+
+  const toml::value in_place = u8R"(
+    name = "histogram"
+    type = "int32[256]"
+    read_mode = "in_place"
+    source = "snapshot"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{in_place}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_alarm_limits", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "temperature"
+    type = "double"
+    min_alarm = "-10"
+    max_alarm = "80"
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.min_alarm == "-10");
+  REQUIRE(parsed.max_alarm == "80");
+  REQUIRE(has_alarms(parsed));
+
+  const toml::value strings = u8R"(
+    name = "notes"
+    type = "string"
+    max_alarm = "80"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{strings}, std::invalid_argument);
+}
+
+TEST_CASE("polling_throws_on_commands_with_parameters", "[command]")
+{
+  const toml::value v = u8R"(
+    name = "square"
+    return_type = "int32"
+    parameter_type = "int32"
+    polling_period_ms = 1000
+)"_toml;
+  REQUIRE_THROWS_AS(command{v}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_refresh_period", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "temperature"
+    type = "double"
+    refresh_ms = 200
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.refresh_ms == 200);
+  REQUIRE(is_refreshed(parsed));
+  REQUIRE(has_snapshot(parsed));
+
+  const toml::value published = u8R"(
+    name = "temperature"
+    type = "double"
+    source = "snapshot"
+    refresh_ms = 200
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{published}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_jpeg_encoding", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "live_view"
+    type = "image/rgb24"
+    encoding = "jpeg"
+    jpeg_quality = 75
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.type.type == value_type::rgb24_t);
+  REQUIRE(parsed.encoding == encoding_t::jpeg);
+  REQUIRE(parsed.jpeg_quality == 75);
+
+  const toml::value gray16 = u8R"(
+    name = "live_view"
+    type = "image/16"
+    encoding = "jpeg"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{gray16}, std::invalid_argument);
+
+  const toml::value raw_quality = u8R"(
+    name = "live_view"
+    type = "image/8"
+    jpeg_quality = 75
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{raw_quality}, std::invalid_argument);
+}
+
+TEST_CASE("reduction_needs_numeric_arrays", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "image"
+    type = "uint16[2048,2048]"
+    reduction = true
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.reduction);
+
+  const toml::value scalar = u8R"(
+    name = "exposure_time"
+    type = "double"
+    reduction = true
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{scalar}, std::invalid_argument);
+
+  const toml::value in_place = u8R"(
+    name = "image"
+    type = "uint16[2048,2048]"
+    read_mode = "in_place"
+    reduction = true
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{in_place}, std::invalid_argument);
+}
+
+TEST_CASE("view_reads_need_numeric_images", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "region"
+    type = "uint16[2048,2048]"
+    read_mode = "view"
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.read_mode == read_mode_t::view);
+
+  const toml::value spectrum = u8R"(
+    name = "trace"
+    type = "uint16[2048]"
+    read_mode = "view"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{spectrum}, std::invalid_argument);
+}
+
+TEST_CASE("shared_memory_needs_published_images", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "frame"
+    type = "uint16[2048,2048]"
+    source = "snapshot"
+    shared_memory = true
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(has_shared_memory(parsed));
+
+  const toml::value called = u8R"(
+    name = "frame"
+    type = "uint16[2048,2048]"
+    shared_memory = true
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{called}, std::invalid_argument);
+}
+
+TEST_CASE("data_ready_needs_readable_attributes", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "image"
+    type = "uint16[2048,2048]"
+    data_ready = true
+)"_toml;
+  attribute parsed{v};
+  REQUIRE(parsed.data_ready);
+
+  const toml::value write_only = u8R"(
+    name = "target"
+    type = "double"
+    access = ["write"]
+    data_ready = true
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{write_only}, std::invalid_argument);
+}
+
+TEST_CASE("view_writes_need_writable_attributes", "[attribute]")
+{
+  const toml::value v = u8R"(
+    name = "region"
+    type = "uint16[64,64]"
+    write_mode = "view"
+)"_toml;
+  REQUIRE_THROWS_AS(attribute{v}, std::invalid_argument);
+}
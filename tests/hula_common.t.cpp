@@ -0,0 +1,142 @@
+#include <catch2/catch_test_macros.hpp>
+#include "hula_common.hpp"
+
+using namespace hula;
+
+TEST_CASE("snapshot_hands_out_the_latest_value", "[snapshot]")
+{
+  snapshot<int> latest;
+  REQUIRE(latest.latest() == nullptr);
+
+  latest.publish(1);
+  latest.publish(2);
+  REQUIRE(latest.latest() != nullptr);
+  REQUIRE(*latest.latest() == 2);
+}
+
+TEST_CASE("snapshot_has_no_value_after_a_failure", "[snapshot]")
+{
+  snapshot<int> latest;
+  latest.publish(1);
+  REQUIRE(*latest.latest() == 1);
+
+  latest.publish_failure();
+  REQUIRE(latest.latest() == nullptr);
+
+  latest.publish(3);
+  REQUIRE(*latest.latest() == 3);
+}
+
+namespace
+{
+// A width x height image whose pixels count up row by row
+image<std::uint16_t> counting_image(std::size_t width, std::size_t height)
+{
+  image<std::uint16_t> result{std::vector<std::uint16_t>(width * height), width, height};
+  for (std::size_t i = 0; i < result.data.size(); ++i)
+    result.data[i] = static_cast<std::uint16_t>(i);
+  return result;
+}
+}
+
+TEST_CASE("image_reduction_crops_to_the_region_of_interest", "[reduction]")
+{
+  image_reduction reduction;
+  reduction.set_roi({1, 1, 2, 2});
+
+  image<std::uint16_t> reduced;
+  reduction.apply(counting_image(4, 3), reduced);
+  REQUIRE(reduced.width == 2);
+  REQUIRE(reduced.height == 2);
+  REQUIRE(reduced.data == std::vector<std::uint16_t>{5, 6, 9, 10});
+}
+
+TEST_CASE("image_reduction_takes_the_rest_for_a_zero_extent", "[reduction]")
+{
+  image_reduction reduction;
+  reduction.set_roi({1, 2, 0, 0});
+
+  image<std::uint16_t> reduced;
+  reduction.apply(counting_image(4, 3), reduced);
+  REQUIRE(reduced.width == 3);
+  REQUIRE(reduced.height == 1);
+  REQUIRE(reduced.data == std::vector<std::uint16_t>{9, 10, 11});
+}
+
+TEST_CASE("image_reduction_averages_blocks", "[reduction]")
+{
+  image_reduction reduction;
+  reduction.set_roi({0, 0, 5, 4});
+  reduction.set_factor(2);
+
+  // The fifth column does not fill a block and is dropped
+  image<std::uint16_t> reduced;
+  reduction.apply(counting_image(5, 4), reduced);
+  REQUIRE(reduced.width == 2);
+  REQUIRE(reduced.height == 2);
+  REQUIRE(reduced.data == std::vector<std::uint16_t>{3, 5, 13, 15});
+}
+
+TEST_CASE("image_reduction_rejects_regions_it_cannot_reduce", "[reduction]")
+{
+  image_reduction reduction;
+  image<std::uint16_t> reduced;
+
+  reduction.set_roi({4, 0, 0, 0});
+  REQUIRE_THROWS_WITH(reduction.apply(counting_image(4, 3), reduced),
+    "The region of interest starts outside of the image");
+
+  reduction.set_roi({0, 0, 2, 2});
+  reduction.set_factor(3);
+  REQUIRE_THROWS_WITH(reduction.apply(counting_image(4, 3), reduced),
+    "The binning factor is larger than the region of interest");
+
+  REQUIRE_THROWS_AS(reduction.set_factor(0), std::invalid_argument);
+}
+
+TEST_CASE("spectrum_reduction_decimates", "[reduction]")
+{
+  spectrum_reduction reduction;
+  reduction.set_roi({1, 0});
+  reduction.set_factor(3);
+
+  std::vector<int> reduced;
+  reduction.apply(std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, reduced);
+  REQUIRE(reduced == std::vector<int>{1, 4, 7});
+
+  reduction.set_roi({2, 3});
+  reduction.set_factor(1);
+  reduction.apply(std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, reduced);
+  REQUIRE(reduced == std::vector<int>{2, 3, 4});
+}
+
+TEST_CASE("image_view_regions_keep_the_stride_of_the_frame", "[image_view]")
+{
+  auto frame = counting_image(4, 3);
+  image_view<std::uint16_t const> view{frame.data.data(), frame.width, frame.height};
+  REQUIRE(view.row_stride() == 4);
+  REQUIRE(view.is_contiguous());
+
+  auto region = view.region(1, 1, 2, 2);
+  REQUIRE(region.data == frame.data.data() + 5);
+  REQUIRE(region.row_stride() == 4);
+  REQUIRE_FALSE(region.is_contiguous());
+  REQUIRE(region.row(1)[1] == 10);
+
+  // A single row is contiguous whatever the stride
+  REQUIRE(view.region(1, 2, 2, 1).is_contiguous());
+}
+
+TEST_CASE("gather_copies_only_strided_views", "[image_view]")
+{
+  auto frame = counting_image(4, 3);
+  image_view<std::uint16_t const> view{frame.data.data(), frame.width, frame.height};
+  std::vector<std::uint16_t> buffer;
+
+  REQUIRE(detail::gather<std::uint16_t>(view, buffer) == frame.data.data());
+  REQUIRE(buffer.empty());
+
+  auto* pixels = detail::gather<std::uint16_t>(view.region(1, 1, 2, 2), buffer);
+  REQUIRE(pixels == buffer.data());
+  REQUIRE(buffer == std::vector<std::uint16_t>{5, 6, 9, 10});
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include "hula_shm.hpp"
+#include <vector>
+#include <sys/wait.h>
+
+using namespace hula::shm;
+
+namespace
+{
+std::string test_segment_name()
+{
+  return "/hula.test." + std::to_string(getpid());
+}
+}
+
+TEST_CASE("segment_name_flattens_the_device_name", "[shm]")
+{
+  REQUIRE(segment_name("test/camera/1", "image") == "/hula.test.camera.1.image");
+}
+
+TEST_CASE("ring_reader_sees_the_frames_of_the_writer", "[shm]")
+{
+  auto name = test_segment_name();
+  ring_writer writer;
+  REQUIRE(writer.latest().frame == 0);
+  writer.open(name, default_slot_count, sizeof(std::uint16_t), 64 * 32);
+  ring_reader reader(name);
+  REQUIRE_FALSE(reader.latest<std::uint16_t>().valid());
+
+  std::vector<std::uint16_t> pixels(64 * 32);
+  for (std::uint16_t frame = 1; frame <= 6; ++frame)
+  {
+    std::fill(pixels.begin(), pixels.end(), frame);
+    auto written = writer.write(pixels.data(), 64, 32);
+    REQUIRE(written.frame == frame);
+    REQUIRE(written.slot == (frame - 1) % default_slot_count);
+  }
+
+  auto latest = reader.latest<std::uint16_t>();
+  REQUIRE(latest.valid());
+  REQUIRE(latest.width == 64);
+  REQUIRE(latest.height == 32);
+  REQUIRE(latest.data[100] == 6);
+
+  SECTION("and notices when a slot was reused")
+  {
+    REQUIRE_FALSE(reader.at<std::uint16_t>({0, 1}).valid());
+    auto older = reader.at<std::uint16_t>({2, 3});
+    REQUIRE(older.valid());
+    REQUIRE(older.data[0] == 3);
+
+    // Frames 7 to 9 wrap around to slot 2 again
+    for (int i = 0; i < 3; ++i)
+      writer.write(pixels.data(), 64, 32);
+    REQUIRE_FALSE(older.valid());
+  }
+
+  SECTION("and rejects frames and types that do not fit")
+  {
+    REQUIRE_THROWS_AS(writer.write(pixels.data(), 128, 32), std::length_error);
+    REQUIRE_THROWS_AS(reader.latest<std::uint8_t>(), std::invalid_argument);
+  }
+}
+
+TEST_CASE("closing_the_writer_removes_the_segment", "[shm]")
+{
+  auto name = test_segment_name();
+  ring_writer writer;
+  writer.open(name, default_slot_count, sizeof(float), 16);
+  writer.close();
+  REQUIRE_THROWS_AS(ring_reader(name), std::system_error);
+}
+
+TEST_CASE("opening_refuses_a_segment_that_another_process_writes", "[shm]")
+{
+  auto name = test_segment_name();
+  int ready[2];
+  int done[2];
+  REQUIRE(pipe(ready) == 0);
+  REQUIRE(pipe(done) == 0);
+
+  auto child = fork();
+  REQUIRE(child >= 0);
+  if (child == 0)
+  {
+    // Writes until told to die, without removing the segment
+    ring_writer writer;
+    writer.open(name, default_slot_count, sizeof(float), 16);
+    char byte = 0;
+    if (write(ready[1], &byte, 1) != 1 || read(done[0], &byte, 1) != 1)
+      _exit(1);
+    _exit(0);
+  }
+
+  char byte = 0;
+  REQUIRE(read(ready[0], &byte, 1) == 1);
+  ring_writer writer;
+  REQUIRE_THROWS_AS(writer.open(name, default_slot_count, sizeof(float), 16), std::system_error);
+
+  REQUIRE(write(done[1], &byte, 1) == 1);
+  int status = 0;
+  REQUIRE(waitpid(child, &status, 0) == child);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+  for (auto fd : {ready[0], ready[1], done[0], done[1]})
+    close(fd);
+
+  // The segment the child left behind is stale now
+  writer.open(name, default_slot_count, sizeof(float), 16);
+  REQUIRE(writer.is_open());
+}
@@ -60,3 +60,154 @@ TEST_CASE("can_parse_device_attributes") {
   raw_device_server_spec device_spec(device);
   REQUIRE(device_spec.attributes.size() == 3);
 }
+
+TEST_CASE("can_parse_batched_reads") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    batched_reads = true
+    [[attributes]]
+    name = "temperature"
+    type = "double"
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.batched_reads);
+}
+
+TEST_CASE("batched_reads_throw_without_attributes_read_on_request") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    batched_reads = true
+    [[attributes]]
+    name = "frame"
+    type = "uint16[64,32]"
+    source = "snapshot"
+)"_toml;
+  REQUIRE_THROWS_AS(raw_device_server_spec(device), std::invalid_argument);
+}
+
+TEST_CASE("can_parse_serialization") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    serialization = "by_class"
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.serialization == serialization_t::by_class);
+}
+
+TEST_CASE("serialization_models_have_to_agree") {
+  const toml::value unspecified = u8R"(
+    name = "quiet_device"
+)"_toml;
+  const toml::value none = u8R"(
+    name = "cool_device"
+    serialization = "none"
+)"_toml;
+  const toml::value by_process = u8R"(
+    name = "lazy_device"
+    serialization = "by_process"
+)"_toml;
+  REQUIRE(serialization_model({device_server_spec{unspecified}}) == serialization_t::by_device);
+  REQUIRE(serialization_model({device_server_spec{unspecified}, device_server_spec{none}}) == serialization_t::none);
+  REQUIRE_THROWS_AS(serialization_model({device_server_spec{none}, device_server_spec{by_process}}), std::invalid_argument);
+}
+
+TEST_CASE("can_parse_state_cache") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    state_cache_ms = 250
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.state_cache_ms == 250);
+}
+
+TEST_CASE("can_opt_out_of_alarm_scan") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    alarm_scan = false
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(!device_spec.alarm_scan);
+  const toml::value defaulted = u8R"(
+    name = "cool_device"
+)"_toml;
+  REQUIRE(raw_device_server_spec(defaulted).alarm_scan);
+}
+
+TEST_CASE("alarm_limits_throw_without_alarm_scan") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    alarm_scan = false
+    [[attributes]]
+    name = "temperature"
+    type = "double"
+    max_alarm = "80"
+)"_toml;
+  REQUIRE_THROWS_AS(raw_device_server_spec(device), std::invalid_argument);
+}
+
+TEST_CASE("can_parse_polling_configuration") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    poll_ring_depth = 32
+
+    [[attributes]]
+    name = "temperature"
+    type = "double"
+    polling_period_ms = 500
+
+    [[commands]]
+    name = "report"
+    return_type = "float"
+    parameter_type = "void"
+    polling_period_ms = 3000
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.poll_ring_depth == 32);
+  REQUIRE(device_spec.attributes.at(0).polling_period_ms == 500);
+  REQUIRE(device_spec.commands.at(0).polling_period_ms == 3000);
+}
+
+TEST_CASE("can_parse_parallel_init") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    parallel_init = 8
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.parallel_init == 8);
+}
+
+TEST_CASE("can_parse_lazy_init") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    lazy_init = true
+    lazy_init_state = "unknown"
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.lazy_init);
+  REQUIRE(device_spec.lazy_init_state == lazy_init_state_t::unknown);
+}
+
+TEST_CASE("lazy_init_throws_with_parallel_init") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    lazy_init = true
+    parallel_init = 4
+)"_toml;
+  REQUIRE_THROWS_AS(raw_device_server_spec{device}, std::invalid_argument);
+}
+
+TEST_CASE("can_parse_group_factory") {
+  const toml::value device = u8R"(
+    name = "cool_device"
+    group_factory = true
+)"_toml;
+  raw_device_server_spec device_spec(device);
+  REQUIRE(device_spec.group_factory);
+
+  const toml::value lazy = u8R"(
+    name = "cool_device"
+    group_factory = true
+    lazy_init = true
+)"_toml;
+  REQUIRE_THROWS_AS(raw_device_server_spec{lazy}, std::invalid_argument);
+}